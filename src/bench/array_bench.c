@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "../engine/types.h"
+#include "../engine/utils.h"
+#include "../engine/list.h"
+#include "../engine/array.h"
+
+// cost of one item access through list_get and through a typed array, prints one JSON object
+// usage: array_bench [--items N] [--passes P]
+// the sums of both runs have to match
+
+// CMake builds the benches with -O2 outside MSVC, an unoptimized build still runs but warns and says so in the JSON
+#if defined(__OPTIMIZE__) || (defined(_MSC_VER) && !defined(_DEBUG))
+#define BENCH_OPTIMIZED true
+#else
+#define BENCH_OPTIMIZED false
+#endif
+#ifndef BENCH_BUILD_TYPE
+#define BENCH_BUILD_TYPE "unknown"
+#endif
+
+// about the size of a body view, what the physics and render loops walk
+typedef struct bench_item {
+    float32 pos[2], velocity[2];
+    void *callbacks[2];
+    uint64 id, entity_id;
+} Bench_item;
+
+ARRAY_DEFINE(Bench_item)
+
+static uint64 time_now_ns(void);
+
+int main(int argc, char **argv) {
+    uint64 item_count = 4096, passes = 20000;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--items") == 0) item_count = strtoull(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "--passes") == 0) passes = strtoull(argv[i + 1], NULL, 10);
+        else {
+            ERROR_RETURN(1, "usage: array_bench [--items N] [--passes P]\n");
+        }
+    }
+    if (item_count == 0 || passes == 0) {
+        ERROR_RETURN(1, "usage: array_bench [--items N] [--passes P]\n");
+    }
+    if (!BENCH_OPTIMIZED) {
+        ERROR_EXIT("array_bench was built without optimization, its timings are not comparable\n");
+    }
+
+    List *list = list_create(item_count, sizeof(Bench_item));
+    Array_Bench_item array = {0};
+    if (!list || !array_Bench_item_reserve(&array, item_count)) {
+        ERROR_RETURN(1, "Unable to allocate memory for bench items\n");
+    }
+    for (uint64 i = 0; i < item_count; i++) {
+        Bench_item item = {.pos = {(float32) i, 1}, .velocity = {1, 0}, .id = i, .entity_id = i & 7};
+        list_append(list, &item);
+        *array_Bench_item_emplace_back(&array) = item;
+    }
+
+    uint64 list_sum = 0, array_sum = 0;
+    uint64 start = time_now_ns();
+    for (uint64 p = 0; p < passes; p++) {
+        for (uint64 i = 0; i < list->len; i++) {
+            Bench_item *item = list_get(list, i);
+            list_sum += item->id + item->entity_id;
+        }
+    }
+    uint64 list_ns = time_now_ns() - start;
+
+    start = time_now_ns();
+    for (uint64 p = 0; p < passes; p++) {
+        for (uint64 i = 0; i < array.len; i++) {
+            Bench_item *item = array_Bench_item_at(&array, i);
+            array_sum += item->id + item->entity_id;
+        }
+    }
+    uint64 array_ns = time_now_ns() - start;
+
+    float64 accesses = (float64) item_count * passes;
+    printf("{\n");
+    printf("  \"items\": %" PRIu64 ", \"passes\": %" PRIu64 ",\n", item_count, passes);
+#ifdef _DEBUG_
+    printf("  \"checked\": true,\n");
+#else
+    printf("  \"checked\": false,\n");
+#endif
+    printf("  \"build_type\": \"%s\", \"optimized\": %s,\n", BENCH_BUILD_TYPE, BENCH_OPTIMIZED ? "true" : "false");
+    printf("  \"list_get_ns_per_access\": %.3f,\n", list_ns / accesses);
+    printf("  \"array_at_ns_per_access\": %.3f,\n", array_ns / accesses);
+    printf("  \"sums_match\": %s\n", (list_sum == array_sum) ? "true" : "false");
+    printf("}\n");
+
+    list_delete(list);
+    array_Bench_item_free(&array);
+    return 0;
+}
+
+static uint64 time_now_ns(void) {
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64) (counter.QuadPart * (1e9 / frequency.QuadPart));
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64) now.tv_sec * 1000000000ull + (uint64) now.tv_nsec;
+#endif
+}
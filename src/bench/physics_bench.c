@@ -0,0 +1,453 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+#include "../engine/types.h"
+#include "../engine/utils.h"
+#include "../engine/physics/physics.h"
+#include "../engine/physics/tilemap.h"
+#include "../engine/workers.h"
+#include "../engine/memory.h"
+
+// synthetic worlds stepped without a window, prints one JSON object per run
+// usage: physics_bench [--bodies N] [--statics M] [--triggers K] [--ticks T] [--threads W]
+//                      [--step-rate R] [--broadphase grid|sap|brute] [--solver sweep|speculative]
+//                      [--seed S] [--snapshots C] [--tilemap E]
+// the checksum compares runs of the same world
+// with --snapshots every tick is saved into a ring of C snapshots, the run then rolls back C - 1 ticks
+// and replays them, the replay has to end with the same checksum, then a body gets another pixel mask
+// between a save and a restore, once with a body created in between, and has to keep it
+// with --tilemap the walls and platforms are tiles meshed into static bodies and E tiles change every tick,
+// which rebuilds their chunks between the ticks, edits can't be replayed so E has to be 0 with --snapshots
+
+// CMake builds the benches with -O2 outside MSVC, an unoptimized build still runs but warns and says so in the JSON
+#if defined(__OPTIMIZE__) || (defined(_MSC_VER) && !defined(_DEBUG))
+#define BENCH_OPTIMIZED true
+#else
+#define BENCH_OPTIMIZED false
+#endif
+#ifndef BENCH_BUILD_TYPE
+#define BENCH_BUILD_TYPE "unknown"
+#endif
+
+typedef struct bench_config {
+    uint32 bodies, statics, triggers, ticks, threads, step_rate, seed, snapshots;
+    bool tilemap;
+    uint32 tile_edits;
+    Physics_broadphase broadphase;
+    Physics_solver solver;
+} Bench_config;
+
+typedef struct bench_counters {
+    uint64 hits, static_hits;
+    uint64 pairs_tested, pairs_culled, contacts;
+    uint64 static_tree_builds;
+    uint64 substeps[PHYSICS_SUBSTEPS_MAX];
+} Bench_counters;
+
+// time one snapshot save or restore of 2000 bodies should stay under, a save or restore is mostly copying
+// the body store and the contact list so whether it does depends on the memory bandwidth of the machine
+#define SNAPSHOT_BUDGET_NS 20000
+// size of a tile of the --tilemap world, the same as the props of the game
+#define BENCH_TILE_SIZE 16
+
+typedef struct bench_snapshot_result {
+    double save_ns, restore_ns;
+    bool replay_matches, masks_kept;
+} Bench_snapshot_result;
+
+static Bench_counters counters;
+static float32 world_width, world_height;
+static Tilemap tilemap;
+
+static bool config_parse(Bench_config *config, int argc, char **argv);
+static void world_build(Bench_config *config);
+static void tilemap_build_world(Bench_config *config);
+static uint64 tilemap_edit(uint32 count);
+static void world_step(float32 frame_delta);
+static Bench_snapshot_result snapshot_rollback(Bench_config *config, uint64 save_ns);
+static bool snapshot_masks_kept(uint64 tick);
+static void on_hit(Body *self, Body *other, Collision *hit);
+static void on_static_hit(Body *self, Static_body *other, Collision *hit);
+static uint32 random_next(void);
+static float32 random_range(float32 min, float32 max);
+static uint64 time_now_ns(void);
+static uint64 peak_memory_bytes(void);
+static uint64 world_checksum(void);
+static const char *broadphase_name(Physics_broadphase broadphase);
+static const char *solver_name(Physics_solver solver);
+
+static uint32 random_state;
+
+int main(int argc, char **argv) {
+    Bench_config config = {
+        .bodies = 1000, .statics = 200, .triggers = 20, .ticks = 600,
+        .threads = 1, .step_rate = 60, .seed = 1, .broadphase = PHYSICS_BROADPHASE_GRID,
+        .solver = PHYSICS_SOLVER_SWEEP
+    };
+    if (!config_parse(&config, argc, argv)) {
+        ERROR_RETURN(1, "usage: physics_bench [--bodies N] [--statics M] [--triggers K] [--ticks T] [--threads W] "
+                        "[--step-rate R] [--broadphase grid|sap|brute] [--solver sweep|speculative] "
+                        "[--seed S] [--snapshots C] [--tilemap E]\n");
+    }
+    if (!BENCH_OPTIMIZED) {
+        ERROR_EXIT("physics_bench was built without optimization, its timings are not comparable\n");
+    }
+
+    physics_init(&(Physics_config){.broadphase = config.broadphase, .solver = config.solver});
+    physics_fixed_step_set(config.step_rate, 1);
+    workers_init(config.threads);
+    random_state = config.seed ? config.seed : 1;
+    world_build(&config);
+    physics_static_bake();
+    if (config.snapshots > 0 && !physics_snapshots_init(config.snapshots, config.bodies + config.triggers))
+        return 1;
+
+    float32 frame_delta = 1.0f / config.step_rate;
+    uint64 elapsed = 0, save_ns = 0, edit_ns = 0, chunks_rebuilt = 0;
+    for (uint32 tick = 0; tick < config.ticks; tick++) {
+        if (config.tile_edits > 0) {
+            uint64 edit_start = time_now_ns();
+            chunks_rebuilt += tilemap_edit(config.tile_edits);
+            edit_ns += time_now_ns() - edit_start;
+        }
+        uint64 start = time_now_ns();
+        world_step(frame_delta);
+        uint64 end = time_now_ns();
+        elapsed += end - start;
+        if (config.snapshots > 0) {
+            physics_snapshot_save(tick);
+            save_ns += time_now_ns() - end;
+        }
+    }
+    Bench_counters run_counters = counters;
+    uint64 checksum = world_checksum();
+    Bench_snapshot_result snapshot = {0};
+    if (config.snapshots > 0) snapshot = snapshot_rollback(&config, save_ns);
+    counters = run_counters;
+
+    uint64 body_ticks = (uint64) (config.bodies + config.triggers) * config.ticks;
+    uint64 ticks = config.ticks ? config.ticks : 1;
+    printf("{\n");
+    printf("  \"bodies\": %u, \"statics\": %u, \"triggers\": %u, \"ticks\": %u,\n",
+           config.bodies, config.statics, config.triggers, config.ticks);
+    printf("  \"threads\": %u, \"broadphase\": \"%s\", \"solver\": \"%s\", \"seed\": %u,\n",
+           workers_count(), broadphase_name(config.broadphase), solver_name(config.solver), config.seed);
+#ifdef PHYSICS_FIXED_POINT
+    printf("  \"fixed_point\": true,\n");
+#else
+    printf("  \"fixed_point\": false,\n");
+#endif
+    printf("  \"build_type\": \"%s\", \"optimized\": %s,\n", BENCH_BUILD_TYPE, BENCH_OPTIMIZED ? "true" : "false");
+    printf("  \"total_ms\": %.3f,\n", elapsed / 1e6);
+    printf("  \"ns_per_body_tick\": %.2f,\n", body_ticks ? (double) elapsed / body_ticks : 0.0);
+    printf("  \"pairs_tested_per_tick\": %.1f,\n", (double) counters.pairs_tested / ticks);
+    printf("  \"pairs_culled_per_tick\": %.1f,\n", (double) counters.pairs_culled / ticks);
+    printf("  \"contacts_per_tick\": %.1f,\n", (double) counters.contacts / ticks);
+    printf("  \"hits\": %" PRIu64 ", \"static_hits\": %" PRIu64 ",\n", counters.hits, counters.static_hits);
+    printf("  \"substeps\": [");
+    for (uint32 i = 0; i < PHYSICS_SUBSTEPS_MAX; i++)
+        printf("%s%" PRIu64, i ? ", " : "", counters.substeps[i]);
+    printf("],\n");
+    if (config.snapshots > 0) {
+        printf("  \"snapshots\": %u,\n", config.snapshots);
+        printf("  \"snapshot_save_ns\": %.1f, \"snapshot_restore_ns\": %.1f,\n", snapshot.save_ns, snapshot.restore_ns);
+        printf("  \"snapshot_budget_ns\": %d, \"snapshot_within_budget\": %s, \"snapshot_budget_note\": \"machine dependent\",\n",
+               SNAPSHOT_BUDGET_NS,
+               (snapshot.save_ns <= SNAPSHOT_BUDGET_NS && snapshot.restore_ns <= SNAPSHOT_BUDGET_NS) ? "true" : "false");
+        printf("  \"replay_matches\": %s, \"masks_kept\": %s,\n", snapshot.replay_matches ? "true" : "false",
+               snapshot.masks_kept ? "true" : "false");
+    }
+    if (config.tilemap) {
+        printf("  \"tilemap_statics\": %" PRIu64 ", \"tile_edits\": %u,\n", tilemap_static_body_count(&tilemap), config.tile_edits);
+        printf("  \"tile_edit_ns\": %.1f, \"chunks_rebuilt_per_tick\": %.2f, \"static_tree_builds\": %" PRIu64 ",\n",
+               (double) edit_ns / ticks, (double) chunks_rebuilt / ticks, counters.static_tree_builds);
+    }
+    printf("  \"peak_memory_bytes\": %" PRIu64 ",\n", peak_memory_bytes());
+    Memory_stats physics_memory = memory_stats_get(MEMORY_TAG_PHYSICS);
+    printf("  \"physics_live_bytes\": %" PRIu64 ", \"physics_peak_bytes\": %" PRIu64 ", \"physics_allocations\": %" PRIu64 ",\n",
+           physics_memory.live_bytes, physics_memory.peak_bytes, physics_memory.allocation_count);
+    printf("  \"checksum\": \"%016" PRIx64 "\"\n", checksum);
+    printf("}\n");
+
+    if (config.tilemap) tilemap_exit(&tilemap);
+    workers_exit();
+    physics_exit();
+    // a replay which ends somewhere else means the snapshots miss part of the state
+    return (config.snapshots > 0 && !(snapshot.replay_matches && snapshot.masks_kept)) ? 1 : 0;
+}
+
+static bool config_parse(Bench_config *config, int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) return false;
+        const char *name = argv[i], *value = argv[++i];
+        if (strcmp(name, "--broadphase") == 0) {
+            if (strcmp(value, "grid") == 0) config->broadphase = PHYSICS_BROADPHASE_GRID;
+            else if (strcmp(value, "sap") == 0) config->broadphase = PHYSICS_BROADPHASE_SAP;
+            else if (strcmp(value, "brute") == 0) config->broadphase = PHYSICS_BROADPHASE_BRUTE_FORCE;
+            else return false;
+            continue;
+        }
+        if (strcmp(name, "--solver") == 0) {
+            if (strcmp(value, "sweep") == 0) config->solver = PHYSICS_SOLVER_SWEEP;
+            else if (strcmp(value, "speculative") == 0) config->solver = PHYSICS_SOLVER_SPECULATIVE;
+            else return false;
+            continue;
+        }
+
+        uint32 number = (uint32) strtoul(value, NULL, 10);
+        if (strcmp(name, "--bodies") == 0) config->bodies = number;
+        else if (strcmp(name, "--statics") == 0) config->statics = number;
+        else if (strcmp(name, "--triggers") == 0) config->triggers = number;
+        else if (strcmp(name, "--ticks") == 0) config->ticks = number;
+        else if (strcmp(name, "--threads") == 0) config->threads = number;
+        else if (strcmp(name, "--step-rate") == 0) config->step_rate = number;
+        else if (strcmp(name, "--seed") == 0) config->seed = number;
+        else if (strcmp(name, "--snapshots") == 0) config->snapshots = number;
+        else if (strcmp(name, "--tilemap") == 0) {
+            config->tilemap = true;
+            config->tile_edits = number;
+        }
+        else return false;
+    }
+    return config->step_rate > 0 && !(config->snapshots > 0 && config->tile_edits > 0);
+}
+
+// a walled box sized so the density stays about the same for any body count
+// dynamic bodies get the layers and masks of the game, triggers are kinematic sensors like the fire
+static void world_build(Bench_config *config) {
+    world_width = fmaxf(640, sqrtf((float32) config->bodies) * 48);
+    world_height = world_width * 0.5625f;
+
+    if (config->tilemap) tilemap_build_world(config);
+    else {
+        physics_static_body_create((Body_data){.pos = {world_width * 0.5f, 16}, .size = {world_width, 32}, .collision_layer = COLLISION_LAYER_TERRAIN});
+        physics_static_body_create((Body_data){.pos = {world_width * 0.5f, world_height - 16}, .size = {world_width, 32}, .collision_layer = COLLISION_LAYER_TERRAIN});
+        physics_static_body_create((Body_data){.pos = {16, world_height * 0.5f}, .size = {32, world_height}, .collision_layer = COLLISION_LAYER_TERRAIN});
+        physics_static_body_create((Body_data){.pos = {world_width - 16, world_height * 0.5f}, .size = {32, world_height}, .collision_layer = COLLISION_LAYER_TERRAIN});
+        for (uint32 i = 0; i < config->statics; i++) {
+            Body_data data = {
+                .pos = {random_range(32, world_width - 32), random_range(32, world_height - 32)},
+                .size = {random_range(16, 96), 16},
+                .collision_layer = (i % 8 == 0) ? COLLISION_LAYER_ENEMY_PASSTHROUGH : COLLISION_LAYER_TERRAIN
+            };
+            physics_static_body_create(data);
+        }
+    }
+
+    for (uint32 i = 0; i < config->bodies; i++) {
+        Body_data data = {
+            .pos = {random_range(48, world_width - 48), random_range(48, world_height - 48)},
+            .size = {random_range(8, 36), random_range(8, 36)},
+            .velocity = {random_range(-200, 200), random_range(-100, 100)}
+        };
+        switch (i % 4) {
+        case 0:
+            data.collision_layer = COLLISION_LAYER_PLAYER;
+            data.collision_mask = COLLISION_LAYER_ENEMY | COLLISION_LAYER_TERRAIN | COLLISION_LAYER_ENEMY_PASSTHROUGH;
+            break;
+        case 3:
+            // fast projectiles which ignore gravity
+            data.collision_layer = COLLISION_LAYER_PROJECTILE;
+            data.collision_mask = COLLISION_LAYER_ENEMY | COLLISION_LAYER_TERRAIN;
+            data.velocity[0] = (data.velocity[0] < 0) ? -680 : 680;
+            data.velocity[1] = 0;
+            data.kinematic = true;
+            break;
+        default:
+            data.collision_layer = COLLISION_LAYER_ENEMY;
+            data.collision_mask = COLLISION_LAYER_PLAYER | COLLISION_LAYER_TERRAIN;
+            break;
+        }
+        physics_body_create(&data, on_hit, on_static_hit);
+    }
+
+    for (uint32 i = 0; i < config->triggers; i++) {
+        vec2 pos = {random_range(64, world_width - 64), random_range(64, world_height - 64)};
+        physics_trigger_create(pos, (vec2){64, 16}, 0, COLLISION_LAYER_PLAYER | COLLISION_LAYER_ENEMY, on_hit);
+    }
+}
+
+// the walls of world_build two tiles thick and its platforms as rows of up to 6 tiles
+static void tilemap_build_world(Bench_config *config) {
+    uint32 width = (uint32) ceilf(world_width / BENCH_TILE_SIZE), height = (uint32) ceilf(world_height / BENCH_TILE_SIZE);
+    if (!tilemap_init(&tilemap, width, height, BENCH_TILE_SIZE, (vec2){0, 0})) {
+        ERROR_EXIT_PROGRAM("Unable to create the bench tilemap\n");
+    }
+    tilemap_tile_layer_set(&tilemap, 1, COLLISION_LAYER_TERRAIN);
+    tilemap_tile_layer_set(&tilemap, 2, COLLISION_LAYER_ENEMY_PASSTHROUGH);
+    for (uint32 y = 0; y < height; y++) {
+        for (uint32 x = 0; x < width; x++) {
+            if (x < 2 || y < 2 || x >= width - 2 || y >= height - 2)
+                tilemap_tile_set(&tilemap, x, y, 1);
+        }
+    }
+    for (uint32 i = 0; i < config->statics; i++) {
+        uint32 length = 1 + random_next() % 6;
+        uint32 x = 2 + random_next() % (width - 10), y = 2 + random_next() % (height - 4);
+        for (uint32 t = 0; t < length; t++)
+            tilemap_tile_set(&tilemap, x + t, y, (i % 8 == 0) ? 2 : 1);
+    }
+    tilemap_build(&tilemap);
+}
+
+// flips count inner tiles between empty and terrain, returns how many chunks were rebuilt
+static uint64 tilemap_edit(uint32 count) {
+    for (uint32 i = 0; i < count; i++) {
+        uint32 x = 2 + random_next() % (tilemap.width - 4), y = 2 + random_next() % (tilemap.height - 4);
+        tilemap_tile_set(&tilemap, x, y, tilemap_tile_get(&tilemap, x, y) ? 0 : 1);
+    }
+    return tilemap_build(&tilemap);
+}
+
+static void world_step(float32 frame_delta) {
+    uint32 steps = physics_frame_begin(frame_delta);
+    for (uint32 s = 0; s < steps; s++) {
+        physics_update();
+        physics_events_dispatch();
+
+        Physics_stats stats = physics_stats_get();
+        counters.pairs_tested += stats.pairs_tested;
+        counters.pairs_culled += stats.pairs_culled;
+        counters.contacts += stats.contacts;
+        counters.static_tree_builds += stats.static_tree_builds;
+        for (uint32 i = 0; i < PHYSICS_SUBSTEPS_MAX; i++)
+            counters.substeps[i] += stats.substeps[i];
+    }
+}
+
+// restores every snapshot still in the ring for the restore timing, then replays from the oldest one
+static Bench_snapshot_result snapshot_rollback(Bench_config *config, uint64 save_ns) {
+    Bench_snapshot_result result = {.save_ns = config->ticks ? (double) save_ns / config->ticks : 0};
+    if (config->ticks == 0) return result;
+    uint64 checksum = world_checksum();
+    uint32 kept = (config->snapshots < config->ticks) ? config->snapshots : config->ticks;
+    uint32 oldest = config->ticks - kept;
+
+    uint64 start = time_now_ns();
+    for (uint32 tick = config->ticks; tick-- > oldest;)
+        physics_snapshot_restore(tick);
+    result.restore_ns = (double) (time_now_ns() - start) / kept;
+
+    float32 frame_delta = 1.0f / config->step_rate;
+    for (uint32 tick = oldest + 1; tick < config->ticks; tick++)
+        world_step(frame_delta);
+    result.replay_matches = world_checksum() == checksum;
+    result.masks_kept = snapshot_masks_kept(config->ticks);
+    return result;
+}
+
+// pixel masks are not part of a snapshot, a restore leaves the mask set after the save on the body,
+// also when a body created after the save makes the restore copy the saved body views
+static bool snapshot_masks_kept(uint64 tick) {
+    uint64 handle = -1;
+    for (uint64 i = 0; i < physics_body_count() && handle == -1; i++)
+        if (physics_body_is_active(physics_body_at(i))) handle = physics_body_handle(physics_body_at(i));
+    uint8 pixels[4] = {255, 255, 255, 0};
+    Pixel_mask saved, set;
+    if (handle == -1 || !pixel_mask_init(&saved, pixels, 2, 1, 2, 2) || !pixel_mask_init(&set, pixels, 2, 2, 2, 1))
+        return false;
+
+    bool kept = true;
+    for (uint32 created = 0; created < 2 && kept; created++) {
+        physics_body_pixel_mask_set(handle, &saved, (vec2){0, 0}, false);
+        physics_snapshot_save(tick + created);
+        physics_body_pixel_mask_set(handle, &set, (vec2){1, 2}, true);
+        if (created && physics_body_create(&(Body_data){.pos = {0, 0}, .size = {4, 4}}, NULL, NULL) == -1) kept = false;
+        Body *body = physics_snapshot_restore(tick + created) ? physics_body_get(handle) : NULL;
+        kept = kept && body && body->pixel_mask == &set && body->mask_offset[0] == 1 && body->mask_offset[1] == 2 &&
+               body->mask_flipped;
+    }
+    physics_body_pixel_mask_set(handle, NULL, (vec2){0, 0}, false);
+    pixel_mask_free(&saved);
+    pixel_mask_free(&set);
+    return kept;
+}
+
+static void on_hit(Body *self, Body *other, Collision *hit) {
+    counters.hits++;
+}
+
+// bounces off walls and stops on floors like the enemies of the game, so the world keeps moving
+static void on_static_hit(Body *self, Static_body *other, Collision *hit) {
+    counters.static_hits++;
+    if (hit->normal[0] > 0) self->velocity[0] = fabsf(self->velocity[0]);
+    if (hit->normal[0] < 0) self->velocity[0] = -fabsf(self->velocity[0]);
+    if (hit->normal[1] > 0) self->velocity[1] = 0;
+}
+
+// xorshift32, the same world on every platform for a seed
+static uint32 random_next(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static float32 random_range(float32 min, float32 max) {
+    return min + (max - min) * (float32) (random_next() >> 8) / (float32) (1 << 24);
+}
+
+static uint64 time_now_ns(void) {
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64) (counter.QuadPart * (1e9 / frequency.QuadPart));
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64) now.tv_sec * 1000000000ull + (uint64) now.tv_nsec;
+#endif
+}
+
+static uint64 peak_memory_bytes(void) {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS memory;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory))) return 0;
+    return (uint64) memory.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return (uint64) usage.ru_maxrss;
+#else
+    return (uint64) usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+// hash of the bits of every body position and velocity, equal checksums mean the same simulation
+static uint64 world_checksum(void) {
+    uint64 hash = 14695981039346656037ull;
+    for (uint64 i = 0; i < physics_body_count(); i++) {
+        Body *body = physics_body_at(i);
+        uint32 bits[4];
+        memcpy(bits, body->pos, sizeof(vec2));
+        memcpy(bits + 2, body->velocity, sizeof(vec2));
+        for (uint32 b = 0; b < 4; b++)
+            hash = (hash ^ bits[b]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static const char *broadphase_name(Physics_broadphase broadphase) {
+    switch (broadphase) {
+    case PHYSICS_BROADPHASE_SAP: return "sap";
+    case PHYSICS_BROADPHASE_BRUTE_FORCE: return "brute";
+    default: return "grid";
+    }
+}
+
+static const char *solver_name(Physics_solver solver) {
+    return (solver == PHYSICS_SOLVER_SPECULATIVE) ? "speculative" : "sweep";
+}
@@ -1,13 +1,21 @@
+#define MEMORY_TAG MEMORY_TAG_ANIMATION
+
 #include "animation.h"
-#include "../list.h"
+#include "../array.h"
+#include "../slot_map.h"
 #include "../utils.h"
 
-static List *animation_def_list;
-static List *animation_list;
+ARRAY_DEFINE(Animation_def)
+ARRAY_DEFINE(Animation)
+
+static Array_Animation_def animation_def_list;
+static Array_Animation animation_list;
+static Slot_map animation_slots;
 
 void animation_init(void) {
-    animation_def_list = list_create(0, sizeof(Animation_def));
-    animation_list = list_create(0, sizeof(Animation));
+    animation_def_list = (Array_Animation_def){0};
+    animation_list = (Array_Animation){0};
+    slot_map_init(&animation_slots, 0);
 }
 
 uint64 animation_def_create(Sprite_sheet *sheet, float32 duration, uint8 row, uint8 *cols, uint8 frame_count) {
@@ -22,29 +30,24 @@ uint64 animation_def_create(Sprite_sheet *sheet, float32 duration, uint8 row, ui
             .duration = duration
         };
     }
-    uint64 animation_def_id = list_append(animation_def_list, &def);
-    ASSERT_RETURN(animation_def_id != -1, -1, "Unable to add to animation_def_list");
+    uint64 animation_def_id = animation_def_list.len;
+    Animation_def *slot = array_Animation_def_emplace_back(&animation_def_list);
+    ASSERT_RETURN(slot, -1, "Unable to add to animation_def_list");
+    *slot = def;
     return animation_def_id;
 }
 
 uint64 animation_create(uint64 animation_def_id, bool does_loop) {
-    uint64 id = animation_list->len;
     ASSERT_RETURN(animation_def_id != -1, -1, "Illegal Animation definition id to create animation\n");
-    Animation *animation;
-    // Find an inactive animation first
-    for (uint64 i = 0; i < animation_list->len; i++) {
-        animation = list_get(animation_list, i);
-        if (!animation->active) {
-            id = i;
-            break;
-        };
-    }
+    // slots of destroyed animations first
+    uint64 id = slot_map_alloc(&animation_slots);
+    ASSERT_RETURN(id != -1, -1, "Unable to add item in animation slots\n");
 
-    if (id >= animation_list->len) {
-        id = list_append(animation_list, &(Animation){0});
-        ASSERT_RETURN(id != -1, -1, "Unable to add item in animation_list\n");
+    if (SLOT_HANDLE_INDEX(id) >= animation_list.len) {
+        Animation *slot = array_Animation_emplace_back(&animation_list);
+        ASSERT_RETURN(slot, -1, "Unable to add item in animation_list\n");
     }
-    animation = list_get(animation_list, id);
+    Animation *animation = array_Animation_at(&animation_list, SLOT_HANDLE_INDEX(id));
     *animation = (Animation){
         .def_id = animation_def_id, .does_loop = does_loop,
         .active = true
@@ -52,16 +55,16 @@ uint64 animation_create(uint64 animation_def_id, bool does_loop) {
     return id;
 }
 
+// NULL once the animation of the handle is destroyed
 Animation *animation_get(uint64 animation_id) {
-    Animation * anim = list_get(animation_list, animation_id);
-    ASSERT_RETURN(anim, NULL, "Cannot access item in animation_list\n");
-    return anim;
+    if (!slot_map_valid(&animation_slots, animation_id)) return NULL;
+    return array_Animation_at(&animation_list, SLOT_HANDLE_INDEX(animation_id));
 }
 
 void animation_update(float32 dt) {
-    for (uint64 i = 0; i < animation_list->len; i++) {
-        Animation *animation = list_get(animation_list, i);
-        Animation_def *def = list_get(animation_def_list, animation->def_id);
+    for (uint64 i = 0; i < animation_list.len; i++) {
+        Animation *animation = array_Animation_at(&animation_list, i);
+        Animation_def *def = array_Animation_def_at(&animation_def_list, animation->def_id);
         animation->current_frame_duration -= dt;
 
         if (animation->current_frame_duration <= 0) {
@@ -77,22 +80,35 @@ void animation_update(float32 dt) {
 void animation_render(uint64 animation_id, vec2 pos, vec2 size, vec4 color) {
     ASSERT_RETURN(animation_id != -1, (void) 0, "Illegal Animation id to render from\n");
     Animation *anim = animation_get(animation_id);
-    if (anim->active) {
+    if (anim && anim->active) {
         ASSERT_RETURN(anim->def_id != -1, (void) 0, "Illegal Animation definition id to render from\n");
-        Animation_def *def = list_get(animation_def_list, anim->def_id);
+        Animation_def *def = array_Animation_def_at(&animation_def_list, anim->def_id);
 
         Animation_frame *frame = &def->frames[anim->current_frame_index];
         render_sprite_sheet_frame(def->sheet, frame->row, frame->col, pos, size, color, anim->is_flipped);
     }
 }
 
+// mask of the frame animation_render draws, NULL when the sheet has none
+Pixel_mask *animation_pixel_mask(uint64 animation_id) {
+    ASSERT_RETURN(animation_id != -1, NULL, "Illegal Animation id to get pixel mask from\n");
+    Animation *anim = animation_get(animation_id);
+    if (!anim || !anim->active) return NULL;
+    Animation_def *def = array_Animation_def_at(&animation_def_list, anim->def_id);
+
+    Animation_frame *frame = &def->frames[anim->current_frame_index];
+    return render_sprite_sheet_mask(def->sheet, frame->row, frame->col);
+}
+
 void animation_destroy(uint64 animation_id) {
-    ASSERT_RETURN(animation_id != -1, (void) 0, "Illegal Animation id to destroy\n");
-    Animation *animation = list_get(animation_list, animation_id);
+    Animation *animation = animation_get(animation_id);
+    if (!animation) return;
+    slot_map_release(&animation_slots, animation_id);
     animation->active = false;
 }
 
 void animation_exit(void) {
-    list_delete(animation_list);
-    list_delete(animation_def_list);
+    array_Animation_free(&animation_list);
+    array_Animation_def_free(&animation_def_list);
+    slot_map_free(&animation_slots);
 }
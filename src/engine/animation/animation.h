@@ -33,6 +33,7 @@ void animation_destroy(uint64 animation_id);
 Animation *animation_get(uint64 animation_id);
 void animation_update(float32 dt);
 void animation_render(uint64 animation_id, vec2 pos, vec2 size, vec4 color);
+Pixel_mask *animation_pixel_mask(uint64 animation_id);
 void animation_exit(void);
 
 #endif // !ANIMATION_H
@@ -0,0 +1,96 @@
+#include <stdlib.h>
+
+#include "arena.h"
+#include "memory.h"
+#include "utils.h"
+
+typedef struct frame_arena_state {
+    uint8 *memory;
+    Arena arenas[2][WORKERS_MAX];
+    uint32 current;
+} Frame_arena_state;
+
+static Frame_arena_state state;
+
+void arena_init(Arena *arena, void *memory, uint64 size) {
+    *arena = (Arena){.memory = memory, .size = size};
+}
+
+// NULL when the arena is full, nothing is allocated then
+void *arena_alloc(Arena *arena, uint64 size) {
+    uint64 begin = (arena->used + ARENA_ALIGNMENT - 1) & ~(uint64) (ARENA_ALIGNMENT - 1);
+    if (begin > arena->size || size > arena->size - begin) {
+        ERROR_RETURN(NULL, "Arena of %" PRIu64 " bytes can't fit %" PRIu64 " more\n", arena->size, size);
+    }
+    arena->used = begin + size;
+    if (arena->used > arena->high_water) arena->high_water = arena->used;
+    return arena->memory + begin;
+}
+
+void arena_reset(Arena *arena) {
+    arena->used = 0;
+}
+
+// gives back everything allocated since used was mark, what was allocated before stays
+void arena_reset_to(Arena *arena, uint64 mark) {
+    if (mark < arena->used) arena->used = mark;
+}
+
+// the two sets of arenas share one block, the only allocation the frame arenas make
+bool frame_arena_init(uint64 size, uint64 worker_size) {
+    frame_arena_exit();
+    size = (size + ARENA_ALIGNMENT - 1) & ~(uint64) (ARENA_ALIGNMENT - 1);
+    worker_size = (worker_size + ARENA_ALIGNMENT - 1) & ~(uint64) (ARENA_ALIGNMENT - 1);
+    uint64 set_size = size + worker_size * (WORKERS_MAX - 1);
+    state.memory = memory_alloc(MEMORY_TAG_GENERAL, set_size * 2);
+    if (!state.memory) {
+        ERROR_RETURN(false, "Unable to allocate memory for frame arenas\n");
+    }
+    for (uint32 set = 0; set < 2; set++) {
+        uint8 *memory = state.memory + set * set_size;
+        arena_init(&state.arenas[set][0], memory, size);
+        for (uint32 w = 1; w < WORKERS_MAX; w++)
+            arena_init(&state.arenas[set][w], memory + size + (w - 1) * worker_size, worker_size);
+    }
+    state.current = 0;
+    return true;
+}
+
+// called once a frame by render_begin
+void frame_arena_begin(void) {
+    if (!state.memory) return;
+    state.current ^= 1;
+    for (uint32 w = 0; w < WORKERS_MAX; w++)
+        arena_reset(&state.arenas[state.current][w]);
+}
+
+void *frame_alloc(uint64 size) {
+    return frame_alloc_worker(0, size);
+}
+
+// only the thread running as worker_index may use its arena, so no lock is needed
+void *frame_alloc_worker(uint32 worker_index, uint64 size) {
+    ASSERT_RETURN(worker_index < WORKERS_MAX, NULL, "Illegal worker index for frame arena\n");
+    if (!state.memory) {
+        ERROR_RETURN(NULL, "Frame arena used before frame_arena_init\n");
+    }
+    return arena_alloc(&state.arenas[state.current][worker_index], size);
+}
+
+// arena of worker_index for this frame, NULL before frame_arena_init
+Arena *frame_arena_worker(uint32 worker_index) {
+    if (!state.memory || worker_index >= WORKERS_MAX) return NULL;
+    return &state.arenas[state.current][worker_index];
+}
+
+// most bytes the arena of worker_index held in a frame, over both sets
+uint64 frame_arena_high_water(uint32 worker_index) {
+    if (!state.memory || worker_index >= WORKERS_MAX) return 0;
+    uint64 a = state.arenas[0][worker_index].high_water, b = state.arenas[1][worker_index].high_water;
+    return (a > b) ? a : b;
+}
+
+void frame_arena_exit(void) {
+    memory_free(state.memory);
+    state = (Frame_arena_state){0};
+}
@@ -0,0 +1,38 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+#include "types.h"
+#include "workers.h"
+
+// every allocation starts on this boundary
+#define ARENA_ALIGNMENT 16
+// sizes of the frame arenas of the calling thread and of every other worker index
+#define FRAME_ARENA_SIZE (1024 * 1024)
+#define FRAME_ARENA_WORKER_SIZE (256 * 1024)
+
+// bump allocator over one block, memory is only given back all at once by arena_reset
+typedef struct arena {
+    uint8 *memory;
+    uint64 size, used;
+    uint64 high_water;  // most bytes used between two resets
+} Arena;
+
+void arena_init(Arena *arena, void *memory, uint64 size);
+void *arena_alloc(Arena *arena, uint64 size);
+void arena_reset(Arena *arena);
+void arena_reset_to(Arena *arena, uint64 mark);
+
+// scratch memory for one frame without malloc, there are two sets of arenas and frame_arena_begin
+// switches to the other set and resets it, so memory taken in one frame stays valid through the next,
+// worker index 0 is the calling thread like in workers_run and every other index has its own arena,
+// physics steps any number of times a frame and gives its worker scratch back after each step with arena_reset_to
+bool frame_arena_init(uint64 size, uint64 worker_size);
+void frame_arena_begin(void);
+void *frame_alloc(uint64 size);
+void *frame_alloc_worker(uint32 worker_index, uint64 size);
+Arena *frame_arena_worker(uint32 worker_index);
+uint64 frame_arena_high_water(uint32 worker_index);
+void frame_arena_exit(void);
+
+#endif // !ARENA_H
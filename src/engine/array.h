@@ -0,0 +1,72 @@
+#ifndef ARRAY_H
+#define ARRAY_H
+
+#include <string.h>
+#include "types.h"
+#include "utils.h"
+#include "memory.h"
+
+// ARRAY_DEFINE(T) generates Array_T, a growable array of T with inline accessors for the hot loops
+// where list_get costs a call, a multiply by item_size and a bounds check,
+// T has to be a single identifier and a zeroed Array_T is an empty array
+//
+//     ARRAY_DEFINE(Body)
+//     Array_Body bodies = {0};
+//     Body *body = array_Body_emplace_back(&bodies);
+//
+// array_T_at only checks the index in _DEBUG_ builds, the items are charged to the MEMORY_TAG of the file
+// expanding ARRAY_DEFINE
+
+#ifdef _DEBUG_
+#define ARRAY_CHECK_INDEX(array, index) \
+    if ((index) >= (array)->len) { ERROR_RETURN(NULL, "Array index out of bounds\n"); }
+#else
+#define ARRAY_CHECK_INDEX(array, index)
+#endif
+
+#define ARRAY_DEFINE(T) \
+typedef struct array_##T { \
+    T *items; \
+    uint64 len, capacity; \
+} Array_##T; \
+\
+static inline T *array_##T##_at(Array_##T *array, uint64 index) { \
+    ARRAY_CHECK_INDEX(array, index) \
+    return &array->items[index]; \
+} \
+\
+/* grows the array to hold at least capacity items without changing its length */ \
+static inline bool array_##T##_reserve(Array_##T *array, uint64 capacity) { \
+    if (capacity <= array->capacity) return true; \
+    T *items = memory_realloc(MEMORY_TAG, array->items, capacity * sizeof(T)); \
+    if (!items) { \
+        ERROR_RETURN(false, "Unable to allocate memory to reserve array\n"); \
+    } \
+    array->items = items; \
+    array->capacity = capacity; \
+    return true; \
+} \
+\
+/* appends an item left for the caller to fill, NULL when the array can't grow */ \
+static inline T *array_##T##_emplace_back(Array_##T *array) { \
+    if (array->len >= array->capacity && \
+        !array_##T##_reserve(array, (array->capacity > 0) ? array->capacity * 2 : 1)) \
+        return NULL; \
+    return &array->items[array->len++]; \
+} \
+\
+/* replaces the items of dest with the ones of src, dest only grows when it is too small */ \
+static inline bool array_##T##_copy(Array_##T *dest, Array_##T *src) { \
+    if (!array_##T##_reserve(dest, src->len)) return false; \
+    if (src->len > 0) \
+        memcpy(dest->items, src->items, src->len * sizeof(T)); \
+    dest->len = src->len; \
+    return true; \
+} \
+\
+static inline void array_##T##_free(Array_##T *array) { \
+    memory_free(array->items); \
+    *array = (Array_##T){0}; \
+}
+
+#endif // !ARRAY_H
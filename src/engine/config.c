@@ -44,7 +44,7 @@ static bool load_config(void) {
 
     load_controls(config_file.data);
 
-    free(config_file.data);
+    memory_free(config_file.data);
     return true;
 }
 
@@ -1,28 +1,29 @@
-#include "../list.h"
+#define MEMORY_TAG MEMORY_TAG_ENTITIES
+
+#include "../array.h"
+#include "../slot_map.h"
 #include "entities.h"
 #include "../utils.h"
 
-static List *entity_list;
+ARRAY_DEFINE(Entity)
+
+static Array_Entity entity_list;
+static Slot_map entity_slots;
 
 void entity_init(void) {
-    entity_list = list_create(0, sizeof(Entity));
+    entity_list = (Array_Entity){0};
+    slot_map_init(&entity_slots, 0);
 }
 
 uint64 entity_create(Body_data *data, Entity_type type, vec2 sprite_offset, On_hit on_hit, On_static_hit on_static_hit, On_update on_update) {
-    uint64 id = entity_list->len;
-    for (uint64 i = 0; i < entity_list->len; i++) {
-        Entity *entity = list_get(entity_list, i);
-        if (!entity->active) {
-            id = i;
-            break;
-        }
-    }
+    uint64 id = slot_map_alloc(&entity_slots);
+    ASSERT_RETURN(id != -1, -1, "Unable to add to entity slots\n");
 
-    if (id == entity_list->len) {
-        uint64 entity_id = list_append(entity_list, &(Entity){0});
-        ASSERT_RETURN(entity_id != -1, -1, "Unable to add to entity list\n");
+    if (SLOT_HANDLE_INDEX(id) == entity_list.len) {
+        Entity *slot = array_Entity_emplace_back(&entity_list);
+        ASSERT_RETURN(slot, -1, "Unable to add to entity list\n");
     }
-    Entity *entity = list_get(entity_list, id);
+    Entity *entity = array_Entity_at(&entity_list, SLOT_HANDLE_INDEX(id));
     *entity = (Entity){
         .body_id = physics_body_create(data, on_hit, on_static_hit),
         .animation_id = -1,
@@ -36,23 +37,31 @@ uint64 entity_create(Body_data *data, Entity_type type, vec2 sprite_offset, On_h
     return id;
 }
 
+// NULL once the entity of the handle is destroyed
 Entity *entity_get(uint64 id) {
-    Entity *entity = list_get(entity_list, id);
-    ASSERT_RETURN(entity, NULL, "Cannot access item in entity_list\n");
-    return entity;
+    if (!slot_map_valid(&entity_slots, id)) return NULL;
+    return array_Entity_at(&entity_list, SLOT_HANDLE_INDEX(id));
+}
+
+// entity of the slot with this index, inactive ones included, for walking every entity
+Entity *entity_at(uint64 index) {
+    return array_Entity_at(&entity_list, index);
 }
 
 uint64 entity_count(void) {
-    return entity_list->len;
+    return entity_list.len;
 }
 
+// stale handles are ignored, so an entity hit twice in one dispatch is only destroyed once
 void entity_destroy(uint64 entity_id) {
-    Entity *entity = list_get(entity_list, entity_id);
-    Body *body = physics_body_get(entity->body_id);
+    Entity *entity = entity_get(entity_id);
+    if (!entity) return;
+    slot_map_release(&entity_slots, entity_id);
     entity->active = false;
-    body->active = false;
+    physics_body_destroy(entity->body_id);
 }
 
 void entity_exit(void) {
-    list_delete(entity_list);
+    array_Entity_free(&entity_list);
+    slot_map_free(&entity_slots);
 }
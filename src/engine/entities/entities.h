@@ -29,6 +29,7 @@ struct entity {
 void entity_init(void);
 uint64 entity_create(Body_data *data, Entity_type type, vec2 sprite_offset, On_hit on_hit, On_static_hit on_static_hit, On_update on_update);
 Entity *entity_get(uint64 id);
+Entity *entity_at(uint64 index);
 void entity_destroy(uint64 entity_id);
 bool entity_damage(uint64 entity_id, uint8 damage);
 uint64 entity_count(void);
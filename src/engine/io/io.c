@@ -21,16 +21,16 @@ File read_file(const char *filepath) {
         if (total_bytes_read + 1024 + 1 > file.size) {
             file.size = total_bytes_read + 1024 + 1;
             if (file.size <= total_bytes_read) {
-                free(file.data);
+                memory_free(file.data);
                 fclose(file_ptr);
                 file.data = NULL;
                 file.size = 0;
                 ERROR_RETURN(file, "File too big :O.\n");
             }
 
-            tmp = realloc(file.data, file.size);
+            tmp = memory_realloc(MEMORY_TAG_IO, file.data, file.size);
             if (!tmp) {
-                free(file.data);
+                memory_free(file.data);
                 fclose(file_ptr);
                 file.data = NULL;
                 file.size = 0;
@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include "../types.h"
+#include "../memory.h"
 
 typedef struct file {
     char *data;
@@ -10,6 +11,7 @@ typedef struct file {
     bool is_valid;
 } File;
 
+// data is charged to MEMORY_TAG_IO, the caller releases it with memory_free
 File read_file(const char *filepath);
 bool write_file(const char *filepath, uint64 size, const char *data);
 
@@ -2,35 +2,50 @@
 #include <string.h>
 #include "list.h"
 
-List *list_create(uint64 initial_capacity, uint64 item_size) {
-    List *list = malloc(sizeof(List));
+List *list_create_tagged(uint64 initial_capacity, uint64 item_size, Memory_tag tag) {
+    List *list = memory_alloc(tag, sizeof(List));
     if (!list) {
         ERROR_RETURN(NULL, "Unable to allocate memory for list\n");
     }
     list->item_size = item_size;
     list->capacity = initial_capacity;
     list->len = 0;
-    list->items = malloc(initial_capacity * item_size);
+    list->tag = tag;
+    list->arena = NULL;
+    list->items = memory_alloc(tag, initial_capacity * item_size);
     if (!list->items) {
-        free(list);
+        memory_free(list);
         ERROR_RETURN(NULL, "Unable to allocate space for memory\n");
     }
     return list;
 }
 
+static bool list_grow(List *list, uint64 count);
+
 uint64 list_append(List *list, void *data) {
-    if (list->len >= list->capacity) {
-        list->capacity = (list->capacity > 0) ? list->capacity * 2 : 1;
-        void *items = realloc(list->items, list->capacity * list->item_size);
-        if (!items) {
-            ERROR_RETURN(-1, "Unable to allocate memory to append item\n");
-        }
-        list->items = items;
-    }
+    if (list->len >= list->capacity && !list_grow(list, 1)) return -1;
     memcpy((uint8 *)list->items + list->len * list->item_size, data, list->item_size);
     return list->len++;
 }
 
+// copies count items from data to the end of the list and returns the index of the first one
+uint64 list_append_n(List *list, void *data, uint64 count) {
+    if (!list_grow(list, count)) return -1;
+    if (count > 0)
+        memcpy((uint8 *)list->items + list->len * list->item_size, data, count * list->item_size);
+    list->len += count;
+    return list->len - count;
+}
+
+// adds count items to the end of the list and returns the first one for the caller to write into,
+// the items are not initialized and the pointer is only good until the list grows again
+void *list_emplace(List *list, uint64 count) {
+    if (!list_grow(list, count)) return NULL;
+    void *items = (uint8 *)list->items + list->len * list->item_size;
+    list->len += count;
+    return items;
+}
+
 void *list_get(List *list, uint64 index) {
     if (index >= list->len) {
         ERROR_RETURN(NULL, "List index out of bounds");
@@ -58,13 +73,101 @@ bool list_remove(List *list, uint64 index) {
 
 void list_delete(List *list) {
     if (list) {
-        if (list->items)
-            free(list->items);
-        free(list);
+        if (!list->arena) memory_free(list->items);
+        memory_free(list);
     }
     else {
         ERROR_EXIT_PROGRAM("illegal pointer to delete list\n");
     }
 }
 
-void list_insert(List *list, uint64 index);
+// shifts the items from index on back by one, index can be the length of the list
+bool list_insert(List *list, uint64 index, void *data) {
+    if (index > list->len) {
+        ERROR_RETURN(false, "List index out of bounds\n");
+    }
+    if (!list_grow(list, 1)) return false;
+    uint8 *index_ptr = (uint8 *)list->items + index * list->item_size;
+    memmove(index_ptr + list->item_size, index_ptr, (list->len - index) * list->item_size);
+    memcpy(index_ptr, data, list->item_size);
+    list->len++;
+    return true;
+}
+
+// unlike list_remove the items after index keep their order
+bool list_remove_ordered(List *list, uint64 index) {
+    if (index >= list->len) {
+        ERROR_RETURN(false, "List index out of bounds\n");
+    }
+    uint8 *index_ptr = (uint8 *)list->items + index * list->item_size;
+    memmove(index_ptr, index_ptr + list->item_size, (list->len - index - 1) * list->item_size);
+    list->len--;
+    return true;
+}
+
+// keeps the capacity for the next fill
+void list_clear(List *list) {
+    list->len = 0;
+}
+
+// grows the list to hold at least capacity items without changing its length
+// a list in an arena leaves its old items there and goes over to the heap once the arena is full
+bool list_reserve(List *list, uint64 capacity) {
+    if (capacity <= list->capacity) return true;
+    if (list->arena) {
+        void *items = arena_alloc(list->arena, capacity * list->item_size);
+        if (!items) {
+            items = memory_alloc(list->tag, capacity * list->item_size);
+            if (!items) {
+                ERROR_RETURN(false, "Unable to allocate memory to reserve list\n");
+            }
+            list->arena = NULL;
+        }
+        if (list->len > 0)
+            memcpy(items, list->items, list->len * list->item_size);
+        list->items = items;
+        list->capacity = capacity;
+        return true;
+    }
+    void *items = memory_realloc(list->tag, list->items, capacity * list->item_size);
+    if (!items) {
+        ERROR_RETURN(false, "Unable to allocate memory to reserve list\n");
+    }
+    list->items = items;
+    list->capacity = capacity;
+    return true;
+}
+
+// makes room for count more items, doubling the capacity so repeated appends stay amortized
+static bool list_grow(List *list, uint64 count) {
+    uint64 needed = list->len + count;
+    if (needed <= list->capacity) return true;
+    uint64 capacity = (list->capacity > 0) ? list->capacity * 2 : 1;
+    while (capacity < needed) capacity *= 2;
+    return list_reserve(list, capacity);
+}
+
+// replaces the items of dest with the ones of src, dest only grows when it is too small
+bool list_copy(List *dest, List *src) {
+    if (dest->item_size != src->item_size) {
+        ERROR_RETURN(false, "Cannot copy between lists of different item sizes\n");
+    }
+    if (!list_reserve(dest, src->len)) return false;
+    if (src->len > 0)
+        memcpy(dest->items, src->items, src->len * src->item_size);
+    dest->len = src->len;
+    return true;
+}
+
+// empties the list and takes its items from arena from now on, the heap items it had are freed,
+// NULL empties a list in an arena and sends it back to the heap and only empties a list on the heap
+// the arena items are not freed, they go away with the arena, so a list has to leave its arena before it is reset
+void list_arena_set(List *list, Arena *arena) {
+    if (list->arena || arena) {
+        if (!list->arena) memory_free(list->items);
+        list->items = NULL;
+        list->capacity = 0;
+    }
+    list->arena = arena;
+    list->len = 0;
+}
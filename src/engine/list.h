@@ -3,17 +3,31 @@
 
 #include <stdbool.h>
 #include "types.h"
+#include "memory.h"
+#include "arena.h"
 
 typedef struct list {
     uint64 len, capacity, item_size;
     void *items;
+    Memory_tag tag;
+    Arena *arena;   // the items come from this arena instead of the heap when it is set, see list_arena_set
 } List;
 
-List *list_create(uint64 capacity, uint64 item_size);
+// the list and its items are charged to the MEMORY_TAG of the file creating it
+#define list_create(capacity, item_size) list_create_tagged(capacity, item_size, MEMORY_TAG)
+
+List *list_create_tagged(uint64 capacity, uint64 item_size, Memory_tag tag);
 uint64 list_append(List *list, void *data);
+uint64 list_append_n(List *list, void *data, uint64 count);
+void *list_emplace(List *list, uint64 count);
 void *list_get(List *list, uint64 index);
 bool list_remove(List *list, uint64 index);
-void list_insert(List *list, uint64 index);
+bool list_remove_ordered(List *list, uint64 index);
+bool list_insert(List *list, uint64 index, void *data);
+bool list_reserve(List *list, uint64 capacity);
+bool list_copy(List *dest, List *src);
+void list_arena_set(List *list, Arena *arena);
+void list_clear(List *list);
 void list_delete(List *list);
 
 #endif // !LIST_H
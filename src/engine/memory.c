@@ -0,0 +1,118 @@
+#include <string.h>
+
+#include "memory.h"
+#include "utils.h"
+
+// workers grow lists from their own threads, so the counters are updated atomically
+#ifdef _MSC_VER
+#include <windows.h>
+#define atomic_load_u64(p) ((uint64) InterlockedCompareExchange64((volatile LONG64 *) (p), 0, 0))
+#define atomic_add_u64(p, v) ((uint64) InterlockedExchangeAdd64((volatile LONG64 *) (p), (LONG64) (v)) + (v))
+#define atomic_cas_u64(p, expected, desired) \
+    ((uint64) InterlockedCompareExchange64((volatile LONG64 *) (p), (LONG64) (desired), (LONG64) (expected)) == (expected))
+#else
+#define atomic_load_u64(p) __atomic_load_n(p, __ATOMIC_RELAXED)
+#define atomic_add_u64(p, v) __atomic_add_fetch(p, v, __ATOMIC_RELAXED)
+#define atomic_cas_u64(p, expected, desired) \
+    __atomic_compare_exchange_n(p, &(uint64){expected}, desired, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#endif
+
+// sits in front of every block, 16 bytes so the memory handed out keeps malloc's alignment
+typedef struct memory_header {
+    uint64 size;
+    uint32 tag;
+    uint32 padding;
+} Memory_header;
+
+static Memory_stats stats[MEMORY_TAG_COUNT];
+
+static const char *tag_names[MEMORY_TAG_COUNT] = {
+    [MEMORY_TAG_GENERAL] = "general",
+    [MEMORY_TAG_PHYSICS] = "physics",
+    [MEMORY_TAG_RENDER] = "render",
+    [MEMORY_TAG_ANIMATION] = "animation",
+    [MEMORY_TAG_ENTITIES] = "entities",
+    [MEMORY_TAG_IO] = "io",
+    [MEMORY_TAG_SDL] = "sdl",
+};
+
+static void stats_add(Memory_tag tag, uint64 old_size, uint64 new_size) {
+    Memory_stats *tag_stats = &stats[tag];
+    atomic_add_u64(&tag_stats->allocation_count, 1);
+    uint64 live = atomic_add_u64(&tag_stats->live_bytes, new_size - old_size);
+    if (new_size <= old_size) return;
+
+    uint64 peak = atomic_load_u64(&tag_stats->peak_bytes);
+    while (live > peak && !atomic_cas_u64(&tag_stats->peak_bytes, peak, live))
+        peak = atomic_load_u64(&tag_stats->peak_bytes);
+
+    // only the allocation that crosses the budget logs, the next one does once live bytes dropped under it again
+    uint64 budget = atomic_load_u64(&tag_stats->budget);
+    if (budget > 0 && live > budget && live - (new_size - old_size) <= budget) {
+        ERROR_EXIT("Memory budget of %s exceeded: %" PRIu64 " of %" PRIu64 " bytes\n", tag_names[tag], live, budget);
+    }
+}
+
+void *memory_alloc(Memory_tag tag, uint64 size) {
+    ASSERT_RETURN(tag < MEMORY_TAG_COUNT, NULL, "Illegal memory tag\n");
+    Memory_header *header = malloc(sizeof(Memory_header) + size);
+    if (!header) return NULL;
+    *header = (Memory_header){.size = size, .tag = tag};
+    stats_add(tag, 0, size);
+    return header + 1;
+}
+
+void *memory_calloc(Memory_tag tag, uint64 count, uint64 size) {
+    if (size > 0 && count > UINT64_MAX / size) return NULL;
+    void *memory = memory_alloc(tag, count * size);
+    if (memory) memset(memory, 0, count * size);
+    return memory;
+}
+
+// the block stays charged to the tag it was first allocated with, NULL leaves ptr untouched like realloc
+void *memory_realloc(Memory_tag tag, void *ptr, uint64 size) {
+    if (!ptr) return memory_alloc(tag, size);
+    Memory_header *header = (Memory_header *) ptr - 1;
+    Memory_header old = *header;
+    header = realloc(header, sizeof(Memory_header) + size);
+    if (!header) return NULL;
+    header->size = size;
+    stats_add(old.tag, old.size, size);
+    return header + 1;
+}
+
+void memory_free(void *ptr) {
+    if (!ptr) return;
+    Memory_header *header = (Memory_header *) ptr - 1;
+    atomic_add_u64(&stats[header->tag].live_bytes, -header->size);
+    free(header);
+}
+
+Memory_stats memory_stats_get(Memory_tag tag) {
+    ASSERT_RETURN(tag < MEMORY_TAG_COUNT, (Memory_stats){0}, "Illegal memory tag\n");
+    return (Memory_stats){
+        .live_bytes = atomic_load_u64(&stats[tag].live_bytes),
+        .peak_bytes = atomic_load_u64(&stats[tag].peak_bytes),
+        .allocation_count = atomic_load_u64(&stats[tag].allocation_count),
+        .budget = atomic_load_u64(&stats[tag].budget),
+    };
+}
+
+// logs once the live bytes of the tag go over budget, 0 removes the budget
+void memory_budget_set(Memory_tag tag, uint64 budget) {
+    ASSERT_RETURN(tag < MEMORY_TAG_COUNT, , "Illegal memory tag\n");
+    stats[tag].budget = budget;
+}
+
+const char *memory_tag_name(Memory_tag tag) {
+    return (tag < MEMORY_TAG_COUNT) ? tag_names[tag] : "unknown";
+}
+
+void memory_report(void) {
+    printf("%-10s %14s %14s %12s %14s\n", "tag", "live bytes", "peak bytes", "allocations", "budget");
+    for (uint32 tag = 0; tag < MEMORY_TAG_COUNT; tag++) {
+        Memory_stats tag_stats = memory_stats_get(tag);
+        printf("%-10s %14" PRIu64 " %14" PRIu64 " %12" PRIu64 " %14" PRIu64 "\n", tag_names[tag],
+               tag_stats.live_bytes, tag_stats.peak_bytes, tag_stats.allocation_count, tag_stats.budget);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stdbool.h>
+#include "types.h"
+
+// every allocation is charged to the subsystem that made it
+typedef enum memory_tag {
+    MEMORY_TAG_GENERAL,
+    MEMORY_TAG_PHYSICS,
+    MEMORY_TAG_RENDER,
+    MEMORY_TAG_ANIMATION,
+    MEMORY_TAG_ENTITIES,
+    MEMORY_TAG_IO,
+    MEMORY_TAG_SDL,         // SDL and SDL_mixer, through SDL_SetMemoryFunctions
+    MEMORY_TAG_COUNT
+} Memory_tag;
+
+// a source file defines MEMORY_TAG before its first include to charge the lists,
+// arrays and slot maps it creates to its subsystem
+#ifndef MEMORY_TAG
+#define MEMORY_TAG MEMORY_TAG_GENERAL
+#endif
+
+typedef struct memory_stats {
+    uint64 live_bytes, peak_bytes;
+    uint64 allocation_count;    // allocations made since start, frees don't lower it
+    uint64 budget;              // 0 is no budget
+} Memory_stats;
+
+void *memory_alloc(Memory_tag tag, uint64 size);
+void *memory_calloc(Memory_tag tag, uint64 count, uint64 size);
+void *memory_realloc(Memory_tag tag, void *ptr, uint64 size);
+void memory_free(void *ptr);
+Memory_stats memory_stats_get(Memory_tag tag);
+void memory_budget_set(Memory_tag tag, uint64 budget);
+const char *memory_tag_name(Memory_tag tag);
+void memory_report(void);
+
+#endif // !MEMORY_H
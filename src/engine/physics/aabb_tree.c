@@ -0,0 +1,279 @@
+#define MEMORY_TAG MEMORY_TAG_PHYSICS
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aabb_tree.h"
+#include "../utils.h"
+
+// items per leaf, small enough to keep the leaf tests cheap
+#define LEAF_SIZE 4
+
+typedef struct aabb_tree_node {
+    vec2 min, max;
+    // leaves own items[first, first + count), inner nodes have count 0 and first is the right child
+    uint32 first, count;
+    uint32 parent;  // AABB_TREE_NONE for the root
+} Aabb_tree_node;
+
+static uint32 build_node(Aabb_tree *tree, uint32 first, uint32 count, uint32 parent);
+static void node_refit(Aabb_tree *tree, uint32 node_index, vec2 min, vec2 max);
+static bool bounds_overlap(const float32 *bounds, vec2 min, vec2 max);
+static bool segment_overlap(vec2 min, vec2 max, vec2 origin, vec2 magnitude);
+static int compare_indices(const void *a, const void *b);
+
+void aabb_tree_init(Aabb_tree *tree) {
+    tree->nodes = list_create(0, sizeof(Aabb_tree_node));
+    tree->items = list_create(0, sizeof(uint32));
+    tree->bounds = list_create(0, sizeof(vec4));
+    tree->leaves = list_create(0, sizeof(uint32));
+}
+
+void aabb_tree_exit(Aabb_tree *tree) {
+    list_delete(tree->nodes);
+    list_delete(tree->items);
+    list_delete(tree->bounds);
+    list_delete(tree->leaves);
+}
+
+void aabb_tree_clear(Aabb_tree *tree) {
+    tree->nodes->len = 0;
+    tree->items->len = 0;
+    tree->bounds->len = 0;
+    tree->leaves->len = 0;
+}
+
+void aabb_tree_insert(Aabb_tree *tree, uint32 index, vec2 min, vec2 max) {
+    vec4 empty = {1, 1, -1, -1};
+    // items which never get inserted keep empty bounds
+    while (tree->bounds->len <= index) {
+        if (list_append(tree->bounds, empty) == -1) return;
+    }
+    float32 *bounds = ((vec4 *) tree->bounds->items)[index];
+    bounds[0] = min[0];
+    bounds[1] = min[1];
+    bounds[2] = max[0];
+    bounds[3] = max[1];
+    list_append(tree->items, &index);
+}
+
+void aabb_tree_build(Aabb_tree *tree) {
+    tree->nodes->len = 0;
+    if (!list_reserve(tree->leaves, tree->bounds->len)) return;
+    tree->leaves->len = tree->bounds->len;
+    memset(tree->leaves->items, 0xff, tree->leaves->len * sizeof(uint32));
+    if (tree->items->len == 0) return;
+    build_node(tree, 0, (uint32) tree->items->len, AABB_TREE_NONE);
+}
+
+// true when the item was inserted before the last build, only those can be updated or removed
+bool aabb_tree_contains(Aabb_tree *tree, uint32 index) {
+    return index < tree->leaves->len && ((uint32 *) tree->leaves->items)[index] != AABB_TREE_NONE;
+}
+
+// moves an item of the tree, the nodes above it are refit until one keeps its bounds,
+// far moves leave the tree looser than a new build would
+void aabb_tree_update(Aabb_tree *tree, uint32 index, vec2 min, vec2 max) {
+    ASSERT_RETURN(aabb_tree_contains(tree, index), (void) 0, "Cannot update an item which is not in the tree\n");
+    float32 *bounds = ((vec4 *) tree->bounds->items)[index];
+    bounds[0] = min[0];
+    bounds[1] = min[1];
+    bounds[2] = max[0];
+    bounds[3] = max[1];
+
+    uint32 leaf_index = ((uint32 *) tree->leaves->items)[index];
+    Aabb_tree_node *leaf = list_get(tree->nodes, leaf_index);
+    uint32 *items = tree->items->items;
+    vec2 leaf_min = {INFINITY, INFINITY}, leaf_max = {-INFINITY, -INFINITY};
+    for (uint32 i = leaf->first; i < leaf->first + leaf->count; i++) {
+        float32 *b = ((vec4 *) tree->bounds->items)[items[i]];
+        // removed items have empty bounds and add nothing
+        leaf_min[0] = fminf(leaf_min[0], b[0]);
+        leaf_min[1] = fminf(leaf_min[1], b[1]);
+        leaf_max[0] = fmaxf(leaf_max[0], b[2]);
+        leaf_max[1] = fmaxf(leaf_max[1], b[3]);
+    }
+    node_refit(tree, leaf_index, leaf_min, leaf_max);
+}
+
+// the item stays in its leaf with empty bounds, no query or raycast finds it until the next build
+void aabb_tree_remove(Aabb_tree *tree, uint32 index) {
+    aabb_tree_update(tree, index, (vec2){INFINITY, INFINITY}, (vec2){-INFINITY, -INFINITY});
+}
+
+// appends the indices of all items whose bounds overlap min/max to result in ascending order
+// returns the number of indices appended
+// stack is a uint32 list owned by the caller so several threads can query the same tree
+uint64 aabb_tree_query(Aabb_tree *tree, vec2 min, vec2 max, List *stack, List *result) {
+    if (tree->nodes->len == 0) return 0;
+
+    Aabb_tree_node *nodes = tree->nodes->items;
+    uint32 *items = tree->items->items;
+    vec4 *bounds = tree->bounds->items;
+    uint64 start_len = result->len;
+
+    uint32 root = 0;
+    stack->len = 0;
+    list_append(stack, &root);
+    while (stack->len > 0) {
+        Aabb_tree_node *node = &nodes[((uint32 *) stack->items)[--stack->len]];
+        if (node->min[0] > max[0] || node->max[0] < min[0] || node->min[1] > max[1] || node->max[1] < min[1])
+            continue;
+
+        if (node->count > 0) {
+            for (uint32 i = node->first; i < node->first + node->count; i++) {
+                if (bounds_overlap(bounds[items[i]], min, max))
+                    list_append(result, &items[i]);
+            }
+            continue;
+        }
+        uint32 left = (uint32) (node - nodes) + 1, right = node->first;
+        list_append(stack, &right);
+        list_append(stack, &left);
+    }
+
+    uint64 found = result->len - start_len;
+    qsort((uint32 *) result->items + start_len, found, sizeof(uint32), compare_indices);
+    return found;
+}
+
+// appends the indices of all items whose bounds the segment from origin to origin + magnitude touches
+// in ascending order, only nodes the segment passes through are visited
+uint64 aabb_tree_raycast(Aabb_tree *tree, vec2 origin, vec2 magnitude, List *stack, List *result) {
+    if (tree->nodes->len == 0) return 0;
+
+    Aabb_tree_node *nodes = tree->nodes->items;
+    uint32 *items = tree->items->items;
+    vec4 *bounds = tree->bounds->items;
+    uint64 start_len = result->len;
+
+    uint32 root = 0;
+    stack->len = 0;
+    list_append(stack, &root);
+    while (stack->len > 0) {
+        Aabb_tree_node *node = &nodes[((uint32 *) stack->items)[--stack->len]];
+        if (!segment_overlap(node->min, node->max, origin, magnitude))
+            continue;
+
+        if (node->count > 0) {
+            for (uint32 i = node->first; i < node->first + node->count; i++) {
+                float32 *b = bounds[items[i]];
+                if (segment_overlap((vec2){b[0], b[1]}, (vec2){b[2], b[3]}, origin, magnitude))
+                    list_append(result, &items[i]);
+            }
+            continue;
+        }
+        uint32 left = (uint32) (node - nodes) + 1, right = node->first;
+        list_append(stack, &right);
+        list_append(stack, &left);
+    }
+
+    uint64 found = result->len - start_len;
+    qsort((uint32 *) result->items + start_len, found, sizeof(uint32), compare_indices);
+    return found;
+}
+
+// splits items[first, first + count) at the middle of the longest axis of their centers
+static uint32 build_node(Aabb_tree *tree, uint32 first, uint32 count, uint32 parent) {
+    uint32 *items = tree->items->items;
+    vec4 *bounds = tree->bounds->items;
+
+    Aabb_tree_node node = {
+        .min = {bounds[items[first]][0], bounds[items[first]][1]},
+        .max = {bounds[items[first]][2], bounds[items[first]][3]},
+        .parent = parent
+    };
+    vec2 center_min = {INFINITY, INFINITY}, center_max = {-INFINITY, -INFINITY};
+    for (uint32 i = first; i < first + count; i++) {
+        float32 *b = bounds[items[i]];
+        for (uint8 axis = 0; axis < 2; axis++) {
+            float32 center = (b[axis] + b[axis + 2]) * 0.5;
+            if (b[axis] < node.min[axis]) node.min[axis] = b[axis];
+            if (b[axis + 2] > node.max[axis]) node.max[axis] = b[axis + 2];
+            if (center < center_min[axis]) center_min[axis] = center;
+            if (center > center_max[axis]) center_max[axis] = center;
+        }
+    }
+
+    uint32 node_index = (uint32) list_append(tree->nodes, &node);
+    if (count <= LEAF_SIZE) {
+        Aabb_tree_node *leaf = list_get(tree->nodes, node_index);
+        leaf->first = first;
+        leaf->count = count;
+        for (uint32 i = first; i < first + count; i++)
+            ((uint32 *) tree->leaves->items)[items[i]] = node_index;
+        return node_index;
+    }
+
+    uint8 axis = (center_max[0] - center_min[0] >= center_max[1] - center_min[1]) ? 0 : 1;
+    float32 split = (center_min[axis] + center_max[axis]) * 0.5;
+
+    uint32 mid = first;
+    for (uint32 i = first; i < first + count; i++) {
+        float32 center = (bounds[items[i]][axis] + bounds[items[i]][axis + 2]) * 0.5;
+        if (center < split) {
+            uint32 temp = items[i];
+            items[i] = items[mid];
+            items[mid++] = temp;
+        }
+    }
+    // all centers on top of each other, split the range in half instead
+    if (mid == first || mid == first + count)
+        mid = first + count / 2;
+
+    build_node(tree, first, mid - first, node_index);
+    uint32 right = build_node(tree, mid, first + count - mid, node_index);
+
+    Aabb_tree_node *inner = list_get(tree->nodes, node_index);
+    inner->first = right;
+    inner->count = 0;
+    return node_index;
+}
+
+// sets the bounds of a node and grows or shrinks its parents to the union of their children
+static void node_refit(Aabb_tree *tree, uint32 node_index, vec2 min, vec2 max) {
+    Aabb_tree_node *nodes = tree->nodes->items;
+    while (node_index != AABB_TREE_NONE) {
+        Aabb_tree_node *node = &nodes[node_index];
+        if (node->min[0] == min[0] && node->min[1] == min[1] && node->max[0] == max[0] && node->max[1] == max[1])
+            return;
+        vec2_dup(node->min, min);
+        vec2_dup(node->max, max);
+
+        node_index = node->parent;
+        if (node_index == AABB_TREE_NONE) return;
+        Aabb_tree_node *left = &nodes[node_index + 1], *right = &nodes[nodes[node_index].first];
+        min[0] = fminf(left->min[0], right->min[0]);
+        min[1] = fminf(left->min[1], right->min[1]);
+        max[0] = fmaxf(left->max[0], right->max[0]);
+        max[1] = fmaxf(left->max[1], right->max[1]);
+    }
+}
+
+static bool bounds_overlap(const float32 *bounds, vec2 min, vec2 max) {
+    return bounds[0] <= max[0] && bounds[2] >= min[0] && bounds[1] <= max[1] && bounds[3] >= min[1];
+}
+
+// slab test of the segment against the box, touching counts
+static bool segment_overlap(vec2 min, vec2 max, vec2 origin, vec2 magnitude) {
+    float32 entry = 0, exit = 1;
+    for (uint8 i = 0; i < 2; i++) {
+        // the empty bounds of removed items and their leaves
+        if (min[i] > max[i]) return false;
+        if (magnitude[i] == 0) {
+            if (origin[i] < min[i] || origin[i] > max[i]) return false;
+            continue;
+        }
+        float32 t1 = (min[i] - origin[i]) / magnitude[i];
+        float32 t2 = (max[i] - origin[i]) / magnitude[i];
+        entry = fmaxf(entry, fminf(t1, t2));
+        exit = fminf(exit, fmaxf(t1, t2));
+    }
+    return entry <= exit;
+}
+
+static int compare_indices(const void *a, const void *b) {
+    uint32 x = *(const uint32 *) a, y = *(const uint32 *) b;
+    return (x > y) - (x < y);
+}
@@ -0,0 +1,31 @@
+#ifndef AABB_TREE_H
+#define AABB_TREE_H
+
+#include <stdbool.h>
+#include <linmath.h>
+#include "../types.h"
+#include "../list.h"
+
+// bounding volume hierarchy flattened into a list, built once for items which don't move,
+// an item already in the tree can be moved or removed with a refit of the nodes above it
+typedef struct aabb_tree {
+    List *nodes;    // Aabb_tree_node in depth first order, the left child follows its parent
+    List *items;    // uint32 item indices, every leaf owns a range of them
+    List *bounds;   // vec4 (min_x, min_y, max_x, max_y) indexed by item index
+    List *leaves;   // uint32 leaf node of each item index, AABB_TREE_NONE for items not in the tree
+} Aabb_tree;
+
+#define AABB_TREE_NONE UINT32_MAX
+
+void aabb_tree_init(Aabb_tree *tree);
+void aabb_tree_clear(Aabb_tree *tree);
+void aabb_tree_insert(Aabb_tree *tree, uint32 index, vec2 min, vec2 max);
+void aabb_tree_build(Aabb_tree *tree);
+bool aabb_tree_contains(Aabb_tree *tree, uint32 index);
+void aabb_tree_update(Aabb_tree *tree, uint32 index, vec2 min, vec2 max);
+void aabb_tree_remove(Aabb_tree *tree, uint32 index);
+uint64 aabb_tree_query(Aabb_tree *tree, vec2 min, vec2 max, List *stack, List *result);
+uint64 aabb_tree_raycast(Aabb_tree *tree, vec2 origin, vec2 magnitude, List *stack, List *result);
+void aabb_tree_exit(Aabb_tree *tree);
+
+#endif // !AABB_TREE_H
@@ -0,0 +1,229 @@
+#define MEMORY_TAG MEMORY_TAG_PHYSICS
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "body_store.h"
+#include "physics_fixed.h"
+#include "../utils.h"
+
+// the arrays of the store in the order they sit in its block
+typedef enum body_column {
+    COLUMN_POS,
+    COLUMN_HALF_SIZE,
+    COLUMN_VELOCITY,
+    COLUMN_ACCELERATION,
+    COLUMN_START_POS,
+    COLUMN_COLLISION_LAYER,
+    COLUMN_COLLISION_MASK,
+    COLUMN_FLAGS,
+    COLUMN_MOTION,
+    COLUMN_SLEEP_TICKS,
+    COLUMN_COUNT
+} Body_column;
+
+// item size of every column
+static const uint64 columns[COLUMN_COUNT] = {
+    [COLUMN_POS] = sizeof(vec2),
+    [COLUMN_HALF_SIZE] = sizeof(vec2),
+    [COLUMN_VELOCITY] = sizeof(vec2),
+    [COLUMN_ACCELERATION] = sizeof(vec2),
+    [COLUMN_START_POS] = sizeof(vec2),
+    [COLUMN_COLLISION_LAYER] = sizeof(uint32),
+    [COLUMN_COLLISION_MASK] = sizeof(uint32),
+    [COLUMN_FLAGS] = sizeof(uint8),
+    [COLUMN_MOTION] = sizeof(uint8),
+    [COLUMN_SLEEP_TICKS] = sizeof(uint8),
+};
+
+static uint64 column_size(uint32 column, uint64 capacity);
+static void **column_items(Body_store *store, uint32 column);
+static uint64 partition_lower_bound(List *partition, uint32 id);
+
+void body_store_init(Body_store *store) {
+    *store = (Body_store){0};
+    for (uint32 i = 0; i < BODY_MOTION_COUNT; i++)
+        store->partitions[i] = list_create(0, sizeof(uint32));
+}
+
+// grows every array to hold at least capacity bodies, the arrays can move
+// the columns are carved from one block, each starting on BODY_STORE_ALIGNMENT
+bool body_store_reserve(Body_store *store, uint64 capacity) {
+    if (capacity <= store->capacity) return true;
+    uint64 new_capacity = (store->capacity > 0) ? store->capacity * 2 : 16;
+    while (new_capacity < capacity) new_capacity *= 2;
+
+    Body_store grown = *store;
+    uint64 size = 0;
+    for (uint32 c = 0; c < COLUMN_COUNT; c++)
+        size += column_size(c, new_capacity);
+    // malloc only promises the alignment of the largest basic type
+    grown.block = memory_alloc(MEMORY_TAG, size + BODY_STORE_ALIGNMENT - 1);
+    if (!grown.block) {
+        ERROR_RETURN(false, "Unable to allocate memory for physics body store\n");
+    }
+    uint8 *column = (uint8 *) (((uintptr_t) grown.block + BODY_STORE_ALIGNMENT - 1) & ~(uintptr_t) (BODY_STORE_ALIGNMENT - 1));
+    for (uint32 c = 0; c < COLUMN_COUNT; c++) {
+        void **items = column_items(&grown, c);
+        // only the first len bodies are in use
+        if (store->len > 0)
+            memcpy(column, *column_items(store, c), store->len * columns[c]);
+        *items = column;
+        column += column_size(c, new_capacity);
+    }
+    memory_free(store->block);
+    grown.capacity = new_capacity;
+    *store = grown;
+    return true;
+}
+
+// copies every body of src over dest, the arrays of dest only move when they are too small
+// the columns a step changes, the other ones are copied by body_store_copy_layout
+bool body_store_copy_state(Body_store *dest, Body_store *src) {
+    if (!body_store_reserve(dest, src->len)) return false;
+    uint64 len = src->len;
+    // the arrays of an empty store can still be NULL
+    if (len > 0) {
+        memcpy(dest->pos, src->pos, len * sizeof(vec2));
+        memcpy(dest->velocity, src->velocity, len * sizeof(vec2));
+        memcpy(dest->acceleration, src->acceleration, len * sizeof(vec2));
+        memcpy(dest->start_pos, src->start_pos, len * sizeof(vec2));
+        memcpy(dest->flags, src->flags, len * sizeof(uint8));
+        memcpy(dest->sleep_ticks, src->sleep_ticks, len * sizeof(uint8));
+    }
+    dest->len = len;
+    return true;
+}
+
+// sizes, layers, motion types and partitions, which only change when bodies are created or destroyed
+bool body_store_copy_layout(Body_store *dest, Body_store *src) {
+    if (!body_store_reserve(dest, src->len)) return false;
+    uint64 len = src->len;
+    if (len > 0) {
+        memcpy(dest->half_size, src->half_size, len * sizeof(vec2));
+        memcpy(dest->collision_layer, src->collision_layer, len * sizeof(uint32));
+        memcpy(dest->collision_mask, src->collision_mask, len * sizeof(uint32));
+        memcpy(dest->motion, src->motion, len * sizeof(uint8));
+    }
+    dest->len = len;
+    for (uint32 i = 0; i < BODY_MOTION_COUNT; i++)
+        if (!list_copy(dest->partitions[i], src->partitions[i])) return false;
+    return true;
+}
+
+// keeps the partitions sorted so every pass walks the arrays forwards
+void body_store_partition_add(Body_store *store, uint32 id, Body_motion motion) {
+    List *partition = store->partitions[motion];
+    uint64 index = partition_lower_bound(partition, id);
+    if (list_append(partition, &id) == -1) return;
+    uint32 *ids = partition->items;
+    memmove(&ids[index + 1], &ids[index], (partition->len - 1 - index) * sizeof(uint32));
+    ids[index] = id;
+    store->motion[id] = motion;
+}
+
+void body_store_partition_remove(Body_store *store, uint32 id) {
+    List *partition = store->partitions[store->motion[id]];
+    uint64 index = partition_lower_bound(partition, id);
+    uint32 *ids = partition->items;
+    if (index == partition->len || ids[index] != id) return;
+    memmove(&ids[index], &ids[index + 1], (partition->len - 1 - index) * sizeof(uint32));
+    partition->len--;
+}
+
+void body_store_free(Body_store *store) {
+    memory_free(store->block);
+    for (uint32 i = 0; i < BODY_MOTION_COUNT; i++)
+        if (store->partitions[i]) list_delete(store->partitions[i]);
+    *store = (Body_store){0};
+}
+
+// applies gravity, terminal velocity and acceleration over delta seconds to the velocity of the given bodies
+void body_store_integrate(Body_store *store, uint32 *ids, uint64 count, float32 gravity, float32 terminal_velocity, float32 delta) {
+#ifdef PHYSICS_FIXED_POINT
+    fixed_integrate(store, ids, count, gravity, terminal_velocity, delta);
+#else
+    uint64 i = 0;
+    gravity *= delta;
+#ifdef BODY_STORE_SSE2
+    // lanes hold x and y of two bodies, the x lanes get no gravity and are never clamped
+    const __m128 gravity_lanes = _mm_set_ps(gravity, 0, gravity, 0);
+    const __m128 delta_lanes = _mm_set1_ps(delta);
+    const __m128 terminal_lanes = _mm_set_ps(terminal_velocity, -INFINITY, terminal_velocity, -INFINITY);
+    for (; i + 2 <= count; i += 2) {
+        float32 *velocity_0 = store->velocity[ids[i]], *velocity_1 = store->velocity[ids[i + 1]];
+        __m128 velocity = body_store_load_pair(velocity_0, velocity_1);
+        __m128 acceleration = body_store_load_pair(store->acceleration[ids[i]], store->acceleration[ids[i + 1]]);
+
+        velocity = _mm_max_ps(_mm_add_ps(velocity, gravity_lanes), terminal_lanes);
+        velocity = _mm_add_ps(velocity, _mm_mul_ps(acceleration, delta_lanes));
+        body_store_store_pair(velocity_0, velocity_1, velocity);
+    }
+#endif
+    for (; i < count; i++) {
+        float32 *velocity = store->velocity[ids[i]];
+        velocity[1] += gravity;
+        // limit y velocity to terminal velocity
+        if (terminal_velocity > velocity[1])
+            velocity[1] = terminal_velocity;
+        velocity[0] += store->acceleration[ids[i]][0] * delta;
+        velocity[1] += store->acceleration[ids[i]][1] * delta;
+    }
+#endif
+}
+
+// applies only the acceleration over delta seconds, for kinematic bodies and triggers
+void body_store_accelerate(Body_store *store, uint32 *ids, uint64 count, float32 delta) {
+#ifdef PHYSICS_FIXED_POINT
+    fixed_accelerate(store, ids, count, delta);
+#else
+    uint64 i = 0;
+#ifdef BODY_STORE_SSE2
+    const __m128 delta_lanes = _mm_set1_ps(delta);
+    for (; i + 2 <= count; i += 2) {
+        float32 *velocity_0 = store->velocity[ids[i]], *velocity_1 = store->velocity[ids[i + 1]];
+        __m128 velocity = body_store_load_pair(velocity_0, velocity_1);
+        __m128 acceleration = body_store_load_pair(store->acceleration[ids[i]], store->acceleration[ids[i + 1]]);
+        body_store_store_pair(velocity_0, velocity_1, _mm_add_ps(velocity, _mm_mul_ps(acceleration, delta_lanes)));
+    }
+#endif
+    for (; i < count; i++) {
+        float32 *velocity = store->velocity[ids[i]];
+        velocity[0] += store->acceleration[ids[i]][0] * delta;
+        velocity[1] += store->acceleration[ids[i]][1] * delta;
+    }
+#endif
+}
+
+// bytes of the column rounded up so the next one stays aligned
+static uint64 column_size(uint32 column, uint64 capacity) {
+    return (capacity * columns[column] + BODY_STORE_ALIGNMENT - 1) & ~(uint64) (BODY_STORE_ALIGNMENT - 1);
+}
+
+static void **column_items(Body_store *store, uint32 column) {
+    switch (column) {
+    case COLUMN_POS: return (void **) &store->pos;
+    case COLUMN_HALF_SIZE: return (void **) &store->half_size;
+    case COLUMN_VELOCITY: return (void **) &store->velocity;
+    case COLUMN_ACCELERATION: return (void **) &store->acceleration;
+    case COLUMN_START_POS: return (void **) &store->start_pos;
+    case COLUMN_COLLISION_LAYER: return (void **) &store->collision_layer;
+    case COLUMN_COLLISION_MASK: return (void **) &store->collision_mask;
+    case COLUMN_FLAGS: return (void **) &store->flags;
+    case COLUMN_MOTION: return (void **) &store->motion;
+    default: return (void **) &store->sleep_ticks;
+    }
+}
+
+// first index in the partition whose id is not below the given one
+static uint64 partition_lower_bound(List *partition, uint32 id) {
+    uint32 *ids = partition->items;
+    uint64 low = 0, high = partition->len;
+    while (low < high) {
+        uint64 middle = (low + high) / 2;
+        if (ids[middle] < id) low = middle + 1;
+        else high = middle;
+    }
+    return low;
+}
@@ -0,0 +1,86 @@
+#ifndef BODY_STORE_H
+#define BODY_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <linmath.h>
+#include "../types.h"
+#include "../list.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BODY_STORE_SSE2
+#include <emmintrin.h>
+#endif
+
+typedef enum body_flag {
+    BODY_FLAG_ACTIVE = 1,
+    // destroyed while events were dispatched, still active until the dispatch is done
+    BODY_FLAG_DESTROY_PENDING = 1 << 1,
+    // at rest, not integrated or stepped but still collided with
+    BODY_FLAG_SLEEPING = 1 << 2,
+    // created with contact_stay
+    BODY_FLAG_CONTACT_STAY = 1 << 3,
+    // created with never_sleep
+    BODY_FLAG_NEVER_SLEEP = 1 << 4
+} Body_flag;
+
+// every pass runs one loop for each motion type instead of checking the type of each body
+typedef enum body_motion {
+    BODY_MOTION_DYNAMIC,    // gravity and acceleration, swept against bodies and static bodies
+    BODY_MOTION_KINEMATIC,  // like dynamic bodies without gravity
+    BODY_MOTION_TRIGGER,    // acceleration, only tested for overlaps with other bodies
+    BODY_MOTION_COUNT
+} Body_motion;
+
+// every array of the store starts on this boundary
+#define BODY_STORE_ALIGNMENT 16
+
+// structure of arrays holding the data read by every physics pass, indexed by body id
+// vec2 arrays keep x and y next to each other so a Body can point at them,
+// bodies 2n and 2n + 1 share one aligned 16 byte line of a vec2 array
+typedef struct body_store {
+    uint64 len, capacity;
+    void *block;    // the one allocation holding every array
+    vec2 *pos, *half_size;
+    vec2 *velocity, *acceleration;
+    // positions at the start of the step, other bodies are tested against these
+    // and rendering interpolates from them
+    vec2 *start_pos;
+    uint32 *collision_layer, *collision_mask;
+    uint8 *flags;
+    uint8 *motion;          // Body_motion
+    uint8 *sleep_ticks;     // steps the body has been at rest for
+    // uint32 ids of the active bodies of each motion type in ascending order
+    List *partitions[BODY_MOTION_COUNT];
+} Body_store;
+
+void body_store_init(Body_store *store);
+bool body_store_reserve(Body_store *store, uint64 capacity);
+bool body_store_copy_state(Body_store *dest, Body_store *src);
+bool body_store_copy_layout(Body_store *dest, Body_store *src);
+void body_store_partition_add(Body_store *store, uint32 id, Body_motion motion);
+void body_store_partition_remove(Body_store *store, uint32 id);
+void body_store_integrate(Body_store *store, uint32 *ids, uint64 count, float32 gravity, float32 terminal_velocity, float32 delta);
+void body_store_accelerate(Body_store *store, uint32 *ids, uint64 count, float32 delta);
+void body_store_free(Body_store *store);
+
+#ifdef BODY_STORE_SSE2
+// x and y of two bodies from anywhere in a vec2 array in one register, the first body in the low lanes
+// bodies 2n and 2n + 1, the usual pair of a partition without gaps, are one aligned load
+static inline __m128 body_store_load_pair(float32 *a, float32 *b) {
+    if (b == a + 2 && ((uintptr_t) a & (BODY_STORE_ALIGNMENT - 1)) == 0)
+        return _mm_load_ps(a);
+    return _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (__m64 *) a), (__m64 *) b);
+}
+
+static inline void body_store_store_pair(float32 *a, float32 *b, __m128 value) {
+    if (b == a + 2 && ((uintptr_t) a & (BODY_STORE_ALIGNMENT - 1)) == 0) {
+        _mm_store_ps(a, value);
+        return;
+    }
+    _mm_storel_pi((__m64 *) a, value);
+    _mm_storeh_pi((__m64 *) b, value);
+}
+#endif
+
+#endif // !BODY_STORE_H
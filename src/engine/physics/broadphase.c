@@ -0,0 +1,369 @@
+#define MEMORY_TAG MEMORY_TAG_PHYSICS
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "broadphase.h"
+#include "../utils.h"
+
+typedef struct grid_item {
+    uint32 index;
+    int32 min_x, min_y, max_x, max_y;
+} Grid_item;
+
+typedef struct sap_endpoint {
+    float32 value;
+    uint32 item;    // item index shifted left by one, the lowest bit is set for max endpoints
+} Sap_endpoint;
+
+static void list_set_len(List *list, uint64 len);
+static uint64 cell_bucket(Spatial_grid *grid, int32 x, int32 y);
+static void sort_indices(uint32 *indices, uint64 count);
+static uint64 unique_indices(uint32 *indices, uint64 count);
+static int compare_indices(const void *a, const void *b);
+static bool endpoint_less(Sap_endpoint *a, Sap_endpoint *b);
+static bool bounds_overlap(const float32 *a, const float32 *b);
+static bool layers_pair(uint32 layer_a, uint32 mask_a, uint32 layer_b, uint32 mask_b);
+
+void grid_init(Spatial_grid *grid, float32 cell_size) {
+    grid->cell_size = cell_size;
+    grid->inv_cell_size = 1.0 / cell_size;
+    grid->bucket_mask = 0;
+    grid->items = list_create(0, sizeof(Grid_item));
+    grid->bounds = list_create(0, sizeof(vec4));
+    grid->buckets = list_create(0, sizeof(uint32));
+    grid->entries = list_create(0, sizeof(uint32));
+}
+
+void grid_exit(Spatial_grid *grid) {
+    list_delete(grid->items);
+    list_delete(grid->bounds);
+    list_delete(grid->buckets);
+    list_delete(grid->entries);
+}
+
+// item_count is the highest item index + 1 which can be inserted before the next clear
+void grid_clear(Spatial_grid *grid, uint64 item_count) {
+    grid->items->len = 0;
+    grid->entries->len = 0;
+    list_set_len(grid->bounds, item_count);
+}
+
+void grid_insert(Spatial_grid *grid, uint32 index, vec2 min, vec2 max) {
+    ASSERT_RETURN(index < grid->bounds->len, (void) 0, "Grid item index out of range\n");
+    float32 *bounds = ((vec4 *) grid->bounds->items)[index];
+    bounds[0] = min[0];
+    bounds[1] = min[1];
+    bounds[2] = max[0];
+    bounds[3] = max[1];
+
+    Grid_item item = {
+        .index = index,
+        .min_x = (int32) floorf(min[0] * grid->inv_cell_size),
+        .min_y = (int32) floorf(min[1] * grid->inv_cell_size),
+        .max_x = (int32) floorf(max[0] * grid->inv_cell_size),
+        .max_y = (int32) floorf(max[1] * grid->inv_cell_size)
+    };
+    list_append(grid->items, &item);
+}
+
+// lays every item out in the entries list grouped by bucket (counting sort)
+void grid_build(Spatial_grid *grid) {
+    Grid_item *items = grid->items->items;
+    uint64 entry_count = 0;
+    for (uint64 i = 0; i < grid->items->len; i++)
+        entry_count += (uint64) (items[i].max_x - items[i].min_x + 1) * (items[i].max_y - items[i].min_y + 1);
+
+    // keep the load factor at or under 0.5
+    uint64 bucket_count = 16;
+    while (bucket_count < entry_count * 2) bucket_count <<= 1;
+    grid->bucket_mask = bucket_count - 1;
+
+    list_set_len(grid->buckets, bucket_count + 1);
+    list_set_len(grid->entries, entry_count);
+    uint32 *buckets = grid->buckets->items;
+    uint32 *entries = grid->entries->items;
+    memset(buckets, 0, (bucket_count + 1) * sizeof(uint32));
+
+    for (uint64 i = 0; i < grid->items->len; i++) {
+        for (int32 y = items[i].min_y; y <= items[i].max_y; y++)
+            for (int32 x = items[i].min_x; x <= items[i].max_x; x++)
+                buckets[cell_bucket(grid, x, y)]++;
+    }
+    // turn the counts into bucket ends
+    for (uint64 i = 1; i < bucket_count; i++)
+        buckets[i] += buckets[i - 1];
+    buckets[bucket_count] = entry_count;
+
+    // fill every bucket from the back so its end becomes its start
+    for (uint64 i = grid->items->len; i-- > 0;) {
+        for (int32 y = items[i].min_y; y <= items[i].max_y; y++)
+            for (int32 x = items[i].min_x; x <= items[i].max_x; x++)
+                entries[--buckets[cell_bucket(grid, x, y)]] = items[i].index;
+    }
+}
+
+// appends the indices of all items whose bounds overlap min/max to result in ascending order
+// returns the number of indices appended
+uint64 grid_query(Spatial_grid *grid, vec2 min, vec2 max, List *result) {
+    if (grid->items->len == 0) return 0;
+
+    int32 min_x = (int32) floorf(min[0] * grid->inv_cell_size);
+    int32 min_y = (int32) floorf(min[1] * grid->inv_cell_size);
+    int32 max_x = (int32) floorf(max[0] * grid->inv_cell_size);
+    int32 max_y = (int32) floorf(max[1] * grid->inv_cell_size);
+
+    uint32 *buckets = grid->buckets->items;
+    uint32 *entries = grid->entries->items;
+    vec4 *bounds = grid->bounds->items;
+    uint64 start_len = result->len;
+
+    for (int32 y = min_y; y <= max_y; y++) {
+        for (int32 x = min_x; x <= max_x; x++) {
+            uint64 bucket = cell_bucket(grid, x, y);
+            for (uint32 e = buckets[bucket]; e < buckets[bucket + 1]; e++) {
+                uint32 index = entries[e];
+                float32 *b = bounds[index];
+                if (b[0] > max[0] || b[2] < min[0] || b[1] > max[1] || b[3] < min[1]) continue;
+                list_append(result, &index);
+            }
+        }
+    }
+
+    // items spanning several cells are found once per cell
+    uint64 found = result->len - start_len;
+    sort_indices((uint32 *) result->items + start_len, found);
+    found = unique_indices((uint32 *) result->items + start_len, found);
+    result->len = start_len + found;
+    return found;
+}
+
+void sap_init(Sweep_and_prune *sap) {
+    sap->bounds = list_create(0, sizeof(vec4));
+    sap->layers = list_create(0, sizeof(uint32));
+    sap->masks = list_create(0, sizeof(uint32));
+    sap->inserted = list_create(0, sizeof(uint8));
+    sap->tracked = list_create(0, sizeof(uint8));
+    sap->endpoints = list_create(0, sizeof(Sap_endpoint));
+    sap->active = list_create(0, sizeof(uint32));
+    sap->active_slots = list_create(0, sizeof(uint32));
+    sap->offsets = list_create(0, sizeof(uint32));
+    sap->overlaps = list_create(0, sizeof(uint32));
+    sap->pairs = list_create(0, sizeof(uint32));
+}
+
+void sap_exit(Sweep_and_prune *sap) {
+    list_delete(sap->bounds);
+    list_delete(sap->layers);
+    list_delete(sap->masks);
+    list_delete(sap->inserted);
+    list_delete(sap->tracked);
+    list_delete(sap->endpoints);
+    list_delete(sap->active);
+    list_delete(sap->active_slots);
+    list_delete(sap->offsets);
+    list_delete(sap->overlaps);
+    list_delete(sap->pairs);
+}
+
+// item_count is the highest item index + 1 which can be inserted before the next build
+// items which are not inserted again lose their endpoints in the next build
+void sap_clear(Sweep_and_prune *sap, uint64 item_count) {
+    list_set_len(sap->bounds, item_count);
+    list_set_len(sap->layers, item_count);
+    list_set_len(sap->masks, item_count);
+    list_set_len(sap->inserted, item_count);
+    list_set_len(sap->tracked, item_count);
+    list_set_len(sap->active_slots, item_count);
+    memset(sap->inserted->items, 0, item_count * sizeof(uint8));
+}
+
+void sap_insert(Sweep_and_prune *sap, uint32 index, vec2 min, vec2 max, uint32 layer, uint32 mask) {
+    ASSERT_RETURN(index < sap->bounds->len, (void) 0, "Sweep and prune item index out of range\n");
+    float32 *bounds = ((vec4 *) sap->bounds->items)[index];
+    bounds[0] = min[0];
+    bounds[1] = min[1];
+    bounds[2] = max[0];
+    bounds[3] = max[1];
+    ((uint32 *) sap->layers->items)[index] = layer;
+    ((uint32 *) sap->masks->items)[index] = mask;
+    ((uint8 *) sap->inserted->items)[index] = 1;
+}
+
+// sorts the endpoints again and finds every overlapping pair
+void sap_build(Sweep_and_prune *sap) {
+    uint8 *inserted = sap->inserted->items, *tracked = sap->tracked->items;
+    vec4 *bounds = sap->bounds->items;
+    uint32 *layers = sap->layers->items, *masks = sap->masks->items;
+    uint64 item_count = sap->bounds->len;
+
+    // drop the endpoints of removed items and move the others to the new bounds
+    Sap_endpoint *endpoints = sap->endpoints->items;
+    uint64 len = 0;
+    for (uint64 i = 0; i < sap->endpoints->len; i++) {
+        uint32 item = endpoints[i].item >> 1;
+        if (item >= item_count || !inserted[item]) {
+            if (item < item_count) tracked[item] = 0;
+            continue;
+        }
+        endpoints[i].value = (endpoints[i].item & 1) ? bounds[item][2] : bounds[item][0];
+        endpoints[len++] = endpoints[i];
+    }
+    sap->endpoints->len = len;
+    for (uint32 i = 0; i < item_count; i++) {
+        if (!inserted[i] || tracked[i]) continue;
+        tracked[i] = 1;
+        list_append(sap->endpoints, &(Sap_endpoint){.value = bounds[i][0], .item = i << 1});
+        list_append(sap->endpoints, &(Sap_endpoint){.value = bounds[i][2], .item = (i << 1) | 1});
+    }
+
+    // insertion sort, close to linear since the order barely changes between builds
+    endpoints = sap->endpoints->items;
+    for (uint64 i = 1; i < sap->endpoints->len; i++) {
+        Sap_endpoint key = endpoints[i];
+        uint64 j = i;
+        for (; j > 0 && endpoint_less(&key, &endpoints[j - 1]); j--)
+            endpoints[j] = endpoints[j - 1];
+        endpoints[j] = key;
+    }
+
+    // an item overlaps on x with every item still open when its min endpoint is reached
+    uint32 *active_slots = sap->active_slots->items;
+    sap->active->len = 0;
+    sap->pairs->len = 0;
+    list_set_len(sap->offsets, item_count + 1);
+    uint32 *offsets = sap->offsets->items;
+    memset(offsets, 0, (item_count + 1) * sizeof(uint32));
+
+    for (uint64 i = 0; i < sap->endpoints->len; i++) {
+        uint32 item = endpoints[i].item >> 1;
+        uint32 *active = sap->active->items;
+        if (endpoints[i].item & 1) {
+            // swap the last open item into the slot of the closing one
+            uint32 slot = active_slots[item], last = active[sap->active->len - 1];
+            active[slot] = last;
+            active_slots[last] = slot;
+            sap->active->len--;
+            continue;
+        }
+        for (uint64 a = 0; a < sap->active->len; a++) {
+            uint32 other = active[a];
+            if (!layers_pair(layers[item], masks[item], layers[other], masks[other])) continue;
+            if (!bounds_overlap(bounds[item], bounds[other])) continue;
+            list_append(sap->pairs, &item);
+            list_append(sap->pairs, &other);
+            offsets[item]++;
+            offsets[other]++;
+        }
+        active_slots[item] = (uint32) sap->active->len;
+        list_append(sap->active, &item);
+    }
+
+    // group the pairs by item, every pair is stored for both of its items
+    for (uint64 i = 1; i <= item_count; i++)
+        offsets[i] += offsets[i - 1];
+    list_set_len(sap->overlaps, offsets[item_count]);
+    uint32 *overlaps = sap->overlaps->items, *pairs = sap->pairs->items;
+    for (uint64 i = 0; i < sap->pairs->len; i += 2) {
+        overlaps[--offsets[pairs[i]]] = pairs[i + 1];
+        overlaps[--offsets[pairs[i + 1]]] = pairs[i];
+    }
+    for (uint64 i = 0; i < item_count; i++)
+        sort_indices(&overlaps[offsets[i]], offsets[i + 1] - offsets[i]);
+}
+
+// appends the indices of all items whose bounds overlap min/max to result in ascending order
+// walks the endpoints up to max, meant for the few queries which don't match an inserted item
+uint64 sap_query(Sweep_and_prune *sap, vec2 min, vec2 max, uint32 layer, uint32 mask, List *result) {
+    Sap_endpoint *endpoints = sap->endpoints->items;
+    vec4 *bounds = sap->bounds->items;
+    uint32 *layers = sap->layers->items, *masks = sap->masks->items;
+    vec4 query = {min[0], min[1], max[0], max[1]};
+    uint64 start_len = result->len;
+
+    for (uint64 i = 0; i < sap->endpoints->len && endpoints[i].value <= max[0]; i++) {
+        if (endpoints[i].item & 1) continue;
+        uint32 item = endpoints[i].item >> 1;
+        if (!layers_pair(layer, mask, layers[item], masks[item])) continue;
+        if (bounds_overlap(bounds[item], query)) list_append(result, &item);
+    }
+
+    uint64 found = result->len - start_len;
+    sort_indices((uint32 *) result->items + start_len, found);
+    return found;
+}
+
+// appends the items overlapping the inserted bounds of index in ascending order, without index itself
+uint64 sap_query_item(Sweep_and_prune *sap, uint32 index, List *result) {
+    if (index + 1 >= sap->offsets->len) return 0;
+    uint32 *offsets = sap->offsets->items, *overlaps = sap->overlaps->items;
+    list_append_n(result, &overlaps[offsets[index]], offsets[index + 1] - offsets[index]);
+    return offsets[index + 1] - offsets[index];
+}
+
+// sorts indices gathered from several queries and removes repeated ones, returns the new count
+uint64 broadphase_indices_unique(uint32 *indices, uint64 count) {
+    sort_indices(indices, count);
+    return unique_indices(indices, count);
+}
+
+static bool endpoint_less(Sap_endpoint *a, Sap_endpoint *b) {
+    if (a->value != b->value) return a->value < b->value;
+    // touching items count as overlapping, so min endpoints go first
+    return (a->item & 1) < (b->item & 1);
+}
+
+static bool bounds_overlap(const float32 *a, const float32 *b) {
+    return a[0] <= b[2] && a[2] >= b[0] && a[1] <= b[3] && a[3] >= b[1];
+}
+
+// either item can collide with the other
+static bool layers_pair(uint32 layer_a, uint32 mask_a, uint32 layer_b, uint32 mask_b) {
+    return (mask_a & layer_b) || (mask_b & layer_a);
+}
+
+static uint64 cell_bucket(Spatial_grid *grid, int32 x, int32 y) {
+    uint32 hash = ((uint32) x * 73856093u) ^ ((uint32) y * 19349663u);
+    return hash & grid->bucket_mask;
+}
+
+// grows the list with zeroed items or shrinks it to len
+static void list_set_len(List *list, uint64 len) {
+    uint8 zero[32] = {0};
+    ASSERT_RETURN(list->item_size <= sizeof(zero), (void) 0, "Grid list item too large\n");
+    if (list->len > len) list->len = len;
+    while (list->len < len) {
+        if (list_append(list, zero) == -1) return;
+    }
+}
+
+// candidate lists are short so insertion sort handles most of them
+static void sort_indices(uint32 *indices, uint64 count) {
+    if (count > 32) {
+        qsort(indices, count, sizeof(uint32), compare_indices);
+        return;
+    }
+    for (uint64 i = 1; i < count; i++) {
+        uint32 key = indices[i];
+        uint64 j = i;
+        for (; j > 0 && indices[j - 1] > key; j--)
+            indices[j] = indices[j - 1];
+        indices[j] = key;
+    }
+}
+
+// removes repeated indices from a sorted array, returns the new count
+static uint64 unique_indices(uint32 *indices, uint64 count) {
+    if (count == 0) return 0;
+    uint64 len = 1;
+    for (uint64 i = 1; i < count; i++) {
+        if (indices[i] != indices[len - 1]) indices[len++] = indices[i];
+    }
+    return len;
+}
+
+static int compare_indices(const void *a, const void *b) {
+    uint32 x = *(const uint32 *) a, y = *(const uint32 *) b;
+    return (x > y) - (x < y);
+}
@@ -0,0 +1,53 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include <linmath.h>
+#include "../types.h"
+#include "../list.h"
+
+// uniform grid stored as a spatial hash, items are referenced by their index
+// queries only read the grid so they can run on several threads at once
+typedef struct spatial_grid {
+    float32 cell_size, inv_cell_size;
+    uint64 bucket_mask;
+    List *items;        // Grid_item for every inserted item
+    List *bounds;       // vec4 (min_x, min_y, max_x, max_y) indexed by item index
+    List *buckets;      // uint32 start of every bucket inside entries, bucket_count + 1 long
+    List *entries;      // uint32 item indices grouped by bucket
+} Spatial_grid;
+
+void grid_init(Spatial_grid *grid, float32 cell_size);
+void grid_clear(Spatial_grid *grid, uint64 item_count);
+void grid_insert(Spatial_grid *grid, uint32 index, vec2 min, vec2 max);
+void grid_build(Spatial_grid *grid);
+uint64 grid_query(Spatial_grid *grid, vec2 min, vec2 max, List *result);
+void grid_exit(Spatial_grid *grid);
+
+// sort and sweep on the x axis, the endpoints stay sorted between builds since items barely move
+// the overlapping pairs are found once per build and kept per item, pairs whose items can't
+// collide in either direction by their layers and masks are never stored
+typedef struct sweep_and_prune {
+    List *bounds;       // vec4 (min_x, min_y, max_x, max_y) indexed by item index
+    List *layers;       // uint32 collision layer indexed by item index
+    List *masks;        // uint32 collision mask indexed by item index
+    List *inserted;     // uint8 indexed by item index, inserted since the last clear
+    List *tracked;      // uint8 indexed by item index, has endpoints in the endpoints list
+    List *endpoints;    // Sap_endpoint sorted by value, min endpoints first on ties
+    List *active;       // uint32 items whose x range is open during the sweep
+    List *active_slots; // uint32 indexed by item index, position inside active
+    List *offsets;      // uint32 start of every item inside overlaps, item count + 1 long
+    List *overlaps;     // uint32 overlapping item indices grouped by item in ascending order
+    List *pairs;        // uint32 pairs found by the sweep
+} Sweep_and_prune;
+
+void sap_init(Sweep_and_prune *sap);
+void sap_clear(Sweep_and_prune *sap, uint64 item_count);
+void sap_insert(Sweep_and_prune *sap, uint32 index, vec2 min, vec2 max, uint32 layer, uint32 mask);
+void sap_build(Sweep_and_prune *sap);
+uint64 sap_query(Sweep_and_prune *sap, vec2 min, vec2 max, uint32 layer, uint32 mask, List *result);
+uint64 sap_query_item(Sweep_and_prune *sap, uint32 index, List *result);
+void sap_exit(Sweep_and_prune *sap);
+
+uint64 broadphase_indices_unique(uint32 *indices, uint64 count);
+
+#endif // !BROADPHASE_H
@@ -1,100 +1,725 @@
+#define MEMORY_TAG MEMORY_TAG_PHYSICS
+
 #include "physics.h"
+#include "broadphase.h"
+#include "aabb_tree.h"
+#include "body_store.h"
+#include "ray_batch.h"
+#include "physics_fixed.h"
+#include "../array.h"
+#include "../arena.h"
 #include "../list.h"
+#include "../slot_map.h"
 #include "../utils.h"
-#include "../global.h"
+#include "../workers.h"
 #include <math.h>
+#include <string.h>
+
+// positions only change through these in the step so the fixed point build stays exact
+#ifdef PHYSICS_FIXED_POINT
+#define step_vec2_add fixed_vec2_add
+#else
+#define step_vec2_add vec2_add
+#endif
+
+// grid cells are a bit larger than the usual body so most bodies land in 1 to 4 cells
+#define BROADPHASE_CELL_SIZE 64
+// extra space around the swept bounds for penetration pushes during the tick
+#define BROADPHASE_MARGIN 2
+// bodies handed to a worker at a time
+#define STEP_CHUNK_SIZE 64
+// starting size of the event queue, a power of 2
+#define EVENT_QUEUE_CAPACITY 1024
+// how far around a destroyed static body the bodies resting on it are woken
+#define STATIC_WAKE_MARGIN 0.5
+// a body moving slower than this in units per second and less than this in units per step is at rest
+#define SLEEP_VELOCITY 1
+#define SLEEP_DISTANCE 0.01
+// steps a body has to be at rest for before it falls asleep
+#define SLEEP_TICKS 30
+// one broadphase group for every layer and one for the bodies without a layer
+#define LAYER_GROUP_NONE PHYSICS_LAYER_COUNT
+#define LAYER_GROUP_COUNT (PHYSICS_LAYER_COUNT + 1)
+
+// events and contacts of one chunk of bodies inside the lists of the worker which stepped it
+typedef struct physics_event_range {
+    uint32 worker;
+    uint64 begin, end;
+    uint64 contact_begin, contact_end;
+} Physics_event_range;
+
+// scratch data of a thread taking part in the step
+typedef struct physics_worker {
+    List *candidates, *static_candidates, *tree_stack;
+    // bounds the candidates were queried with
+    vec2 query_min, query_max;
+    List *events;   // Collision_event found by this worker during the step
+    List *contacts; // Collision_event for every body pair touching during the step, once per pair
+    List *wakes;    // uint32 sleeping bodies touched during the step
+    List *speculative;  // Speculative_contact of the body being stepped by the speculative solver
+    Physics_stats stats;
+    // frame arena of the worker index the lists take their items from during a step, NULL without frame arenas,
+    // everything past arena_mark is given back when the step ends
+    Arena *arena;
+    uint64 arena_mark;
+} Physics_worker;
+
+// static body near the path of a body, grown by the half size of the body so the body moves as a point
+typedef struct speculative_contact {
+    uint32 static_id;
+    AABB grown;
+    vec2 min, max;
+} Speculative_contact;
+
+// the move of one body through the speculative solver
+typedef struct speculative_move {
+    uint64 body_id;
+    vec2 distance;          // of the whole step
+    uint32 substeps;        // the sweep would take, for the slide after a stop
+    uint64 event_begin;     // first event of the body in this step
+    // where the body was after each part of its move and the axis of the part, from the start of the step
+    vec2 path[5];
+    uint8 path_axis[4];
+    uint32 path_len;
+} Speculative_move;
+
+// two bodies which touched in the last step, events for them are built from the bodies
+typedef struct contact_pair {
+    uint32 self_id, other_id;
+} Contact_pair;
+
+ARRAY_DEFINE(Body)
+ARRAY_DEFINE(Static_body)
+ARRAY_DEFINE(Physics_worker)
+ARRAY_DEFINE(Physics_event_range)
+ARRAY_DEFINE(vec4)
+
+// everything a step changes, saved between steps
+// body views, the body store layout, body slots and static bodies only change when bodies are created or destroyed
+// or static bodies change, a slot keeps its copy of them while the version it was taken at is still the current one
+typedef struct physics_snapshot {
+    uint64 tick;
+    bool saved;
+    Body_store store;
+    Slot_map body_slots;
+    List *contacts;
+    float32 gravity, terminal_velocity, accumulator;
+    uint64 views_version, layout_version, static_version;
+    Array_Body body_views;
+    Array_Static_body static_bodies;
+    List *static_free;
+} Physics_snapshot;
+
+// ring buffer of collision events waiting for physics_events_dispatch
+typedef struct event_queue {
+    Collision_event *events;
+    uint64 head, len, capacity;
+} Event_queue;
 
 typedef struct physics_internal_state {
+    Physics_broadphase broadphase;
+    Physics_solver solver;
+    // gravity is in units per second squared, velocities in units per second
     float32 gravity, terminal_velocity;
-    List *body_list, *static_body_list;
+    // fixed_delta is 0 when every frame runs one step as long as the frame
+    float32 fixed_delta, accumulator, step_delta;
+    uint32 max_steps;
+    // hot body data lives in the store, body_list keeps the Body views and cold data
+    Body_store store;
+    // body handles, the id of a body inside physics is the index of its slot
+    Slot_map body_slots;
+    Array_Body body_list;
+    Array_Static_body static_body_list;
+    List *static_free;  // uint32 slots of destroyed static bodies
+    // the grid and brute force broadphases keep the bodies of every layer group apart and a body only
+    // queries the groups it can collide with in either direction, tested_by[l] holds the groups of the
+    // bodies whose mask has layer l, rebuilt every step
+    Spatial_grid layer_grids[LAYER_GROUP_COUNT];
+    List *layer_ids[LAYER_GROUP_COUNT];     // uint32 bodies of every group for the brute force broadphase
+    uint64 tested_by[PHYSICS_LAYER_COUNT];
+    uint64 filled_groups;
+    Sweep_and_prune sap;
+    Array_vec4 body_bounds; // swept bounds of every body for the brute force broadphase
+    Aabb_tree static_tree;
+    bool static_tree_dirty;
+    // active bodies where the last step left them, rebuilt by the first query after a change
+    Aabb_tree query_tree;
+    bool query_tree_dirty;
+    List *query_stack, *query_items;
+    Array_Physics_worker workers;
+    Array_Physics_event_range event_ranges;
+    // uint32 ids of the awake bodies grouped by motion type, step_ranges holds where each group starts
+    List *step_ids;
+    uint64 step_ranges[BODY_MOTION_COUNT + 1];
+    Event_queue event_queue;
+    // Contact_pair of the touching bodies sorted by self_id then other_id,
+    // the pairs of the last step are merged with the new ones into contacts_next
+    List *contacts, *contacts_next;
+    // contacts of this step in pair order, the motion types are stepped one after the other
+    List *contacts_found;
+    // bodies destroyed by callbacks are kept until the dispatch is done
+    bool dispatching;
+    List *pending_destroys;
+    // AABB of the static bodies destroyed since the last step, the sleeping bodies resting on them wake up
+    List *static_wakes;
+    // ring of snapshots indexed by tick, the versions are taken from version_counter
+    // so a version is never reused after a restore
+    Physics_snapshot *snapshots;
+    uint32 snapshot_count;
+    uint64 version_counter, views_version, layout_version, static_version;
+    Physics_stats stats;
 } Physics_internal_state;
 
 static Physics_internal_state state;
 
-static uint32 iterations = 2;
-static float32 tick_rate;
-
-static void stationary_response(Body *body);
-static void sweep_response(Body *body, vec2 distance);
-static Collision sweep_static_bodies(Body *body, vec2 velocity);
-static Collision sweep_bodies(Body *body, vec2 velocity);
-static void update_sweep_result(Collision *result, Body *body, uint64 other_id, vec2 velocity);
-static void update_sweep_result_static(Collision *result, Body *body, uint64 other_id, vec2 velocity);
+static void body_views_update(void);
+static void snapshot_free(Physics_snapshot *snapshot);
+static bool body_views_restore(Array_Body *views);
+static void body_destroy(uint32 index);
+static void body_wake(uint32 index);
+static void query_trees_update(void);
+static void static_tree_refit(uint32 index, AABB *aabb);
+static void static_wakes_flush(void);
+static uint64 query_collect(AABB *aabb, vec2 point, uint32 collision_mask, Physics_query_hit *hits, uint64 max_hits);
+static bool query_ray_hit(Physics_query_hit *hit, vec2 origin, vec2 magnitude, AABB aabb);
+static uint64 query_hit_insert(Physics_query_hit *hits, uint64 count, uint64 max_hits, Physics_query_hit *hit);
+static AABB body_aabb(uint64 body_id);
+static AABB body_start_aabb(uint64 body_id);
+static void sleep_update(void);
+static bool body_sleep_update(uint32 body_id);
+static void wake_touched(Physics_worker *worker, uint64 body_id);
+static uint32 body_substeps(uint64 body_id);
+static void workers_update(void);
+static void workers_release(void);
+static void worker_arena_set(Physics_worker *worker, Arena *arena);
+static Arena *query_scratch_begin(uint64 *mark);
+static void query_scratch_end(Arena *arena, uint64 mark);
+static void step_chunk(void *data, uint32 worker_index, uint64 chunk);
+static void step_bodies(Physics_worker *worker, uint32 *ids, uint64 count);
+static void step_triggers(Physics_worker *worker, uint32 *ids, uint64 count);
+static void step_bodies_speculative(Physics_worker *worker, uint32 *ids, uint64 count);
+static void speculative_contacts(Physics_worker *worker, uint64 body_id);
+static bool speculative_solve_axis(Physics_worker *worker, Speculative_move *move, uint8 axis, float32 travel,
+                                   float32 extra);
+static Collision speculative_first_hit(Physics_worker *worker, Speculative_move *move);
+static float32 speculative_slide(float32 free_travel, float32 travel, float32 start, float32 target, uint32 substeps);
+static bool speculative_side_end(Physics_worker *worker, Speculative_move *move, uint8 axis, float32 side, float32 from,
+                                 float32 to, float32 *end);
+static float32 speculative_resume(float32 travel, float32 start, float32 side, float32 other_travel, float32 other_from,
+                                  float32 other_clear, uint32 substeps);
+static void speculative_static_hit(Physics_worker *worker, Speculative_move *move, uint32 static_id, Collision *collision);
+static void speculative_touch_bodies(Physics_worker *worker, Speculative_move *move);
+static bool speculative_segment_touch(vec2 from, uint8 axis, float32 to, vec2 min, vec2 max, Collision *collision);
+static void events_collect(void);
+static void event_queue_push(Collision_event *event);
+static Collision_event *event_queue_at(uint64 index);
+static void event_push(Physics_worker *worker, uint64 body_id, uint64 other_id, Collision_event_kind kind, Collision *collision);
+static void contact_touch(Physics_worker *worker, uint64 body_id, uint64 other_id, Collision *collision);
+static bool pixel_masks_touch(uint64 body_id, uint64 other_id);
+static void pixel_mask_corner(int32 corner[2], Body *body, float32 *center);
+static void contacts_unique(List *contacts, uint64 begin);
+static void contacts_update(void);
+static void contact_lost(Contact_pair *pair);
+static Contact_pair contact_pair(Collision_event *contact);
+static bool contact_less(Contact_pair a, Contact_pair b);
+static int contact_compare(const void *a, const void *b);
+static uint64 body_create(Body_data *data, On_hit on_hit, On_static_hit on_static_hit, Body_motion motion);
+static void swept_bounds(vec2 min, vec2 max, uint64 body_id);
+static void broadphase_update(uint64 body_count);
+static void broadphase_query(Physics_worker *worker, uint64 body_id, bool refit);
+static void broadphase_query_bodies(Physics_worker *worker, uint64 body_id, vec2 min, vec2 max, bool refit);
+static uint64 body_groups(uint64 body_id);
+static uint64 body_query_groups(uint64 body_id);
+static void brute_force_query(uint32 group, vec2 min, vec2 max, List *result);
+static bool broadphase_refit(Physics_worker *worker, uint64 body_id);
+static void stationary_response(Physics_worker *worker, uint64 body_id);
+static void sweep_response(Physics_worker *worker, uint64 body_id, vec2 distance);
+static Collision sweep_static_bodies(Physics_worker *worker, uint64 body_id, vec2 velocity);
+static Collision sweep_bodies(Physics_worker *worker, uint64 body_id, vec2 velocity);
+static void sweep_batch(Collision *result, uint64 body_id, vec2 velocity, Ray_batch *batch, uint32 *ids, bool is_static);
+static void update_sweep_result(Collision *result, Collision *hit, uint64 other_id, vec2 velocity);
+static void update_sweep_result_static(Collision *result, Collision *hit, uint64 other_id, vec2 velocity);
 
-void physics_init(void) {
-    state.body_list = list_create(0, sizeof(Body));
-    state.static_body_list = list_create(0, sizeof(Static_body));
+// config can be NULL for the default settings
+void physics_init(Physics_config *config) {
+    state.broadphase = config ? config->broadphase : PHYSICS_BROADPHASE_GRID;
+    state.solver = config ? config->solver : PHYSICS_SOLVER_SWEEP;
+    body_store_init(&state.store);
+    if (!slot_map_init(&state.body_slots, 0)) {
+        ERROR_EXIT_PROGRAM("Unable to allocate memory for physics body slots\n");
+    }
+    state.body_list = (Array_Body){0};
+    state.static_body_list = (Array_Static_body){0};
+    state.static_free = list_create(0, sizeof(uint32));
+    state.workers = (Array_Physics_worker){0};
+    state.event_ranges = (Array_Physics_event_range){0};
+    state.step_ids = list_create(0, sizeof(uint32));
+    state.pending_destroys = list_create(0, sizeof(uint32));
+    state.static_wakes = list_create(0, sizeof(AABB));
+    state.contacts = list_create(0, sizeof(Contact_pair));
+    state.contacts_next = list_create(0, sizeof(Contact_pair));
+    state.contacts_found = list_create(0, sizeof(Collision_event));
+    state.event_queue = (Event_queue){
+        .events = memory_alloc(MEMORY_TAG, EVENT_QUEUE_CAPACITY * sizeof(Collision_event)),
+        .capacity = EVENT_QUEUE_CAPACITY
+    };
+    if (!state.event_queue.events) {
+        ERROR_EXIT_PROGRAM("Unable to allocate memory for physics event queue\n");
+    }
+    for (uint32 g = 0; g < LAYER_GROUP_COUNT; g++) {
+        grid_init(&state.layer_grids[g], BROADPHASE_CELL_SIZE);
+        state.layer_ids[g] = list_create(0, sizeof(uint32));
+    }
+    sap_init(&state.sap);
+    state.body_bounds = (Array_vec4){0};
+    aabb_tree_init(&state.static_tree);
+    state.static_tree_dirty = false;
+    aabb_tree_init(&state.query_tree);
+    state.query_tree_dirty = true;
+    state.query_stack = list_create(0, sizeof(uint32));
+    state.query_items = list_create(0, sizeof(uint32));
 
-    state.gravity = -75;
+    // the old per frame gravity of -75 at 60 frames per second
+    state.gravity = -4500;
     state.terminal_velocity = -7000;
-
-    tick_rate = 1.0 / iterations;
+    state.fixed_delta = 0;
+    state.max_steps = 1;
 }
 
 void physics_exit(void) {
-    list_delete(state.body_list);
-    list_delete(state.static_body_list);
+    body_store_free(&state.store);
+    slot_map_free(&state.body_slots);
+    array_Body_free(&state.body_list);
+    array_Static_body_free(&state.static_body_list);
+    list_delete(state.static_free);
+    for (uint64 i = 0; i < state.workers.len; i++) {
+        Physics_worker *worker = array_Physics_worker_at(&state.workers, i);
+        list_delete(worker->candidates);
+        list_delete(worker->static_candidates);
+        list_delete(worker->tree_stack);
+        list_delete(worker->events);
+        list_delete(worker->contacts);
+        list_delete(worker->wakes);
+        list_delete(worker->speculative);
+    }
+    array_Physics_worker_free(&state.workers);
+    array_Physics_event_range_free(&state.event_ranges);
+    list_delete(state.step_ids);
+    list_delete(state.pending_destroys);
+    list_delete(state.static_wakes);
+    list_delete(state.contacts);
+    list_delete(state.contacts_next);
+    list_delete(state.contacts_found);
+    memory_free(state.event_queue.events);
+    for (uint32 g = 0; g < LAYER_GROUP_COUNT; g++) {
+        grid_exit(&state.layer_grids[g]);
+        list_delete(state.layer_ids[g]);
+    }
+    sap_exit(&state.sap);
+    array_vec4_free(&state.body_bounds);
+    aabb_tree_exit(&state.static_tree);
+    aabb_tree_exit(&state.query_tree);
+    list_delete(state.query_stack);
+    list_delete(state.query_items);
+    for (uint32 i = 0; i < state.snapshot_count; i++)
+        snapshot_free(&state.snapshots[i]);
+    memory_free(state.snapshots);
+    state.snapshots = NULL;
+    state.snapshot_count = 0;
+}
+
+// step_rate steps per second, 0 goes back to one step per frame
+// max_steps limits the steps one frame can run to catch up after a slow frame
+void physics_fixed_step_set(uint32 step_rate, uint32 max_steps) {
+    state.fixed_delta = (step_rate == 0) ? 0 : 1.0 / step_rate;
+    state.max_steps = (max_steps == 0) ? 1 : max_steps;
+    state.accumulator = 0;
 }
 
+// returns how many times physics_update has to run for a frame of frame_delta seconds
+uint32 physics_frame_begin(float32 frame_delta) {
+    if (state.fixed_delta == 0) {
+        state.step_delta = frame_delta;
+        return 1;
+    }
+
+    state.step_delta = state.fixed_delta;
+    state.accumulator += frame_delta;
+    uint32 steps = (uint32) (state.accumulator / state.fixed_delta);
+    if (steps > state.max_steps) {
+        // the time which can't be caught up is dropped instead of piling up
+        steps = state.max_steps;
+        state.accumulator = fmodf(state.accumulator, state.fixed_delta);
+    }
+    else {
+        state.accumulator -= steps * state.fixed_delta;
+    }
+    return steps;
+}
+
+// how far the time of the frame is between the last two steps, for rendering
+float32 physics_alpha(void) {
+    if (state.fixed_delta == 0) return 1;
+    float32 alpha = state.accumulator / state.fixed_delta;
+    return (alpha > 1) ? 1 : alpha;
+}
+
+// one step of step_delta seconds, set by physics_frame_begin
 void physics_update(void) {
-    Body *body;
-    for (uint64 i = 0; i < state.body_list->len; i++) {
-        body = list_get(state.body_list, i);
-
-        if (!body->active) continue;
-        if (!body->kinematic) {
-            body->velocity[1] += state.gravity;
-            // limit y velocity to terminal velocity
-            if (state.terminal_velocity > body->velocity[1])
-                body->velocity[1] = state.terminal_velocity;
-        }
+    // only bodies which exist when the tick starts take part in it
+    uint64 body_count = state.store.len;
+    state.stats = (Physics_stats){0};
+    if (state.static_tree_dirty) {
+        physics_static_bake();
+        state.stats.static_tree_builds = 1;
+    }
 
-        body->velocity[0] += body->acceleration[0];
-        body->velocity[1] += body->acceleration[1];
+    static_wakes_flush();
+    sleep_update();
+    uint32 *step_ids = state.step_ids->items;
+    uint64 *ranges = state.step_ranges;
+    body_store_integrate(&state.store, &step_ids[ranges[BODY_MOTION_DYNAMIC]],
+                         ranges[BODY_MOTION_DYNAMIC + 1] - ranges[BODY_MOTION_DYNAMIC],
+                         state.gravity, state.terminal_velocity, state.step_delta);
+    body_store_accelerate(&state.store, &step_ids[ranges[BODY_MOTION_KINEMATIC]],
+                          ranges[BODY_MOTION_COUNT] - ranges[BODY_MOTION_KINEMATIC], state.step_delta);
+    memcpy(state.store.start_pos, state.store.pos, body_count * sizeof(vec2));
 
-        // scale velocity with delta time to use in calculations
-        vec2 distance;
-        vec2_scale(distance, body->velocity, timing.delta * tick_rate);
-        // one sweep response and one stationary response for each iteration
-        for (int j = 0; j < iterations; j++) {
-            sweep_response(body, distance);
-            stationary_response(body);
+    broadphase_update(body_count);
+    workers_update();
+
+    // every body only moves itself and sees the others where they started the tick,
+    // so chunks of bodies can be stepped in any order on any thread
+    uint64 chunk_count = (state.step_ids->len + STEP_CHUNK_SIZE - 1) / STEP_CHUNK_SIZE;
+    if (!array_Physics_event_range_reserve(&state.event_ranges, chunk_count)) {
+        ERROR_EXIT_PROGRAM("Unable to allocate memory for physics event ranges\n");
+    }
+    memset(state.event_ranges.items, 0, chunk_count * sizeof(Physics_event_range));
+    state.event_ranges.len = chunk_count;
+    workers_run(step_chunk, NULL, chunk_count);
+
+    // before the wakes, contacts_update tells the stepped bodies apart by their sleeping flag
+    events_collect();
+    contacts_update();
+
+    for (uint64 i = 0; i < state.workers.len; i++) {
+        Physics_worker *worker = array_Physics_worker_at(&state.workers, i);
+        state.stats.pairs_tested += worker->stats.pairs_tested;
+        state.stats.pairs_culled += worker->stats.pairs_culled;
+        for (uint32 s = 0; s < PHYSICS_SUBSTEPS_MAX; s++)
+            state.stats.substeps[s] += worker->stats.substeps[s];
+
+        // the touched bodies step again from the next tick on
+        uint32 *wakes = worker->wakes->items;
+        for (uint64 w = 0; w < worker->wakes->len; w++)
+            body_wake(wakes[w]);
+    }
+    workers_release();
+    state.query_tree_dirty = true;
+}
+
+Physics_stats physics_stats_get(void) {
+    return state.stats;
+}
+
+uint64 physics_event_count(void) {
+    return state.event_queue.len;
+}
+
+// copies up to max_count queued events whose layers are in self_layers and other_layers, oldest first
+// the events stay queued, returns the number of events copied
+uint64 physics_events_filter(uint32 self_layers, uint32 other_layers, Collision_event *events, uint64 max_count) {
+    uint64 count = 0;
+    for (uint64 i = 0; i < state.event_queue.len && count < max_count; i++) {
+        Collision_event *event = event_queue_at(i);
+        if ((event->self_layer & self_layers) && (event->other_layer & other_layers))
+            events[count++] = *event;
+    }
+    return count;
+}
+
+// empties the event queue into the on_hit and on_static_hit callbacks, oldest first
+// bodies destroyed by the callbacks get no more events and are removed once the queue is empty
+void physics_events_dispatch(void) {
+    Event_queue *queue = &state.event_queue;
+    state.dispatching = true;
+
+    while (queue->len > 0) {
+        Collision_event event = *event_queue_at(0);
+        queue->head = (queue->head + 1) & (queue->capacity - 1);
+        queue->len--;
+
+        // callbacks can create bodies and move the store
+        uint8 *flags = state.store.flags;
+        if ((flags[event.self_id] & (BODY_FLAG_ACTIVE | BODY_FLAG_DESTROY_PENDING)) != BODY_FLAG_ACTIVE) continue;
+        Body *body = physics_body_at(event.self_id);
+        Collision collision = {
+            .collided = true, .time = event.time,
+            .normal = {event.normal[0], event.normal[1]}, .other_id = event.other_id, .kind = event.kind
+        };
+
+        if (event.kind == COLLISION_EVENT_STATIC_HIT) {
+            if (body->on_static_hit)
+                body->on_static_hit(body, array_Static_body_at(&state.static_body_list, event.other_id), &collision);
+        }
+        else if ((flags[event.other_id] & (BODY_FLAG_ACTIVE | BODY_FLAG_DESTROY_PENDING)) == BODY_FLAG_ACTIVE) {
+            if (body->on_hit)
+                body->on_hit(body, physics_body_at(event.other_id), &collision);
         }
     }
+
+    state.dispatching = false;
+    uint32 *pending_destroys = state.pending_destroys->items;
+    for (uint64 i = 0; i < state.pending_destroys->len; i++)
+        body_destroy(pending_destroys[i]);
+    state.pending_destroys->len = 0;
+}
+
+// writes up to max_hits bodies and static bodies overlapping aabb into hits and returns how many,
+// bodies come first, both in ascending id order
+uint64 physics_query_aabb(AABB *aabb, uint32 collision_mask, Physics_query_hit *hits, uint64 max_hits) {
+    return query_collect(aabb, NULL, collision_mask, hits, max_hits);
+}
+
+uint64 physics_query_point(vec2 point, uint32 collision_mask, Physics_query_hit *hits, uint64 max_hits) {
+    AABB aabb = { .pos = {point[0], point[1]}, .half_size = {0, 0} };
+    return query_collect(&aabb, point, collision_mask, hits, max_hits);
+}
+
+// nearest box along the segment from origin to origin + magnitude
+bool physics_raycast(vec2 origin, vec2 magnitude, uint32 collision_mask, Physics_query_hit *hit) {
+    return physics_raycast_all(origin, magnitude, collision_mask, hit, 1) > 0;
+}
+
+// the max_hits nearest boxes along the segment sorted by time, ties keep bodies before static bodies
+uint64 physics_raycast_all(vec2 origin, vec2 magnitude, uint32 collision_mask, Physics_query_hit *hits, uint64 max_hits) {
+    if (max_hits == 0) return 0;
+    query_trees_update();
+    uint64 count = 0, mark;
+    Arena *arena = query_scratch_begin(&mark);
+
+    state.query_items->len = 0;
+    aabb_tree_raycast(&state.query_tree, origin, magnitude, state.query_stack, state.query_items);
+    uint32 *items = state.query_items->items;
+    for (uint64 i = 0; i < state.query_items->len; i++) {
+        uint32 id = items[i];
+        if (!(state.store.collision_layer[id] & collision_mask)) continue;
+        Physics_query_hit hit = { .id = id, .is_static = false };
+        if (query_ray_hit(&hit, origin, magnitude, body_aabb(id)))
+            count = query_hit_insert(hits, count, max_hits, &hit);
+    }
+
+    state.query_items->len = 0;
+    aabb_tree_raycast(&state.static_tree, origin, magnitude, state.query_stack, state.query_items);
+    items = state.query_items->items;
+    for (uint64 i = 0; i < state.query_items->len; i++) {
+        Static_body *static_body = array_Static_body_at(&state.static_body_list, items[i]);
+        if (!(static_body->collision_layer & collision_mask)) continue;
+        Physics_query_hit hit = { .id = items[i], .is_static = true };
+        if (query_ray_hit(&hit, origin, magnitude, static_body->aabb))
+            count = query_hit_insert(hits, count, max_hits, &hit);
+    }
+    query_scratch_end(arena, mark);
+    return count;
+}
+
+// allocates a ring of count snapshots with room for body_capacity bodies each, the ring grows later if needed
+bool physics_snapshots_init(uint32 count, uint64 body_capacity) {
+    ASSERT_RETURN(count > 0, false, "Cannot create an empty snapshot ring\n");
+    for (uint32 i = 0; i < state.snapshot_count; i++)
+        snapshot_free(&state.snapshots[i]);
+    memory_free(state.snapshots);
+    state.snapshot_count = 0;
+    state.snapshots = memory_calloc(MEMORY_TAG, count, sizeof(Physics_snapshot));
+    if (!state.snapshots) {
+        ERROR_RETURN(false, "Unable to allocate memory for physics snapshots\n");
+    }
+    state.snapshot_count = count;
+
+    for (uint32 i = 0; i < count; i++) {
+        Physics_snapshot *snapshot = &state.snapshots[i];
+        body_store_init(&snapshot->store);
+        if (!slot_map_init(&snapshot->body_slots, body_capacity)) return false;
+        snapshot->contacts = list_create(body_capacity, sizeof(Contact_pair));
+        if (!array_Body_reserve(&snapshot->body_views, body_capacity) ||
+            !array_Static_body_reserve(&snapshot->static_bodies, state.static_body_list.len))
+            return false;
+        snapshot->static_free = list_create(0, sizeof(uint32));
+        if (!body_store_reserve(&snapshot->store, body_capacity)) return false;
+    }
+    return true;
+}
+
+// saves the state after the given tick into slot tick % count, call it outside of physics_events_dispatch
+void physics_snapshot_save(uint64 tick) {
+    if (state.snapshot_count == 0) {
+        ERROR_RETURN(, "Cannot save a snapshot before physics_snapshots_init\n");
+    }
+    ASSERT_RETURN(!state.dispatching, (void) 0, "Cannot save a snapshot while events are dispatched\n");
+    Physics_snapshot *snapshot = &state.snapshots[tick % state.snapshot_count];
+    snapshot->saved = false;
+    // the wakes are not saved, a restore has to find the bodies resting on destroyed static bodies awake
+    static_wakes_flush();
+    if (!body_store_copy_state(&snapshot->store, &state.store) || !list_copy(snapshot->contacts, state.contacts)) return;
+    if (snapshot->layout_version != state.layout_version) {
+        if (!body_store_copy_layout(&snapshot->store, &state.store) ||
+            !slot_map_copy(&snapshot->body_slots, &state.body_slots))
+            return;
+        snapshot->layout_version = state.layout_version;
+    }
+    if (snapshot->views_version != state.views_version) {
+        if (!array_Body_copy(&snapshot->body_views, &state.body_list)) return;
+        snapshot->views_version = state.views_version;
+    }
+    if (snapshot->static_version != state.static_version) {
+        if (!array_Static_body_copy(&snapshot->static_bodies, &state.static_body_list) ||
+            !list_copy(snapshot->static_free, state.static_free))
+            return;
+        snapshot->static_version = state.static_version;
+    }
+    snapshot->gravity = state.gravity;
+    snapshot->terminal_velocity = state.terminal_velocity;
+    snapshot->accumulator = state.accumulator;
+    snapshot->tick = tick;
+    snapshot->saved = true;
+}
+
+// puts the world back to where it was after the given tick, returns false if the ring no longer holds it
+// events which were not dispatched yet are dropped
+bool physics_snapshot_restore(uint64 tick) {
+    if (state.snapshot_count == 0) {
+        ERROR_RETURN(false, "Cannot restore a snapshot before physics_snapshots_init\n");
+    }
+    ASSERT_RETURN(!state.dispatching, false, "Cannot restore a snapshot while events are dispatched\n");
+    Physics_snapshot *snapshot = &state.snapshots[tick % state.snapshot_count];
+    if (!snapshot->saved || snapshot->tick != tick) return false;
+
+    uint64 capacity = state.store.capacity;
+    if (!body_store_copy_state(&state.store, &snapshot->store) || !list_copy(state.contacts, snapshot->contacts))
+        return false;
+    // every body created or destroyed moves the layout version, the slots only differ when it does
+    if (snapshot->layout_version != state.layout_version) {
+        if (!body_store_copy_layout(&state.store, &snapshot->store) ||
+            !slot_map_restore(&state.body_slots, &snapshot->body_slots))
+            return false;
+        state.layout_version = snapshot->layout_version;
+    }
+    bool views_changed = snapshot->views_version != state.views_version;
+    if (views_changed) {
+        if (!body_views_restore(&snapshot->body_views)) return false;
+        state.views_version = snapshot->views_version;
+    }
+    // bodies created after the snapshot are dropped, their handles stay invalid since slot_map_restore
+    // gives their slots a newer generation than any handle to them
+    state.body_list.len = state.store.len;
+    if (views_changed || capacity != state.store.capacity) body_views_update();
+
+    if (snapshot->static_version != state.static_version) {
+        if (!array_Static_body_copy(&state.static_body_list, &snapshot->static_bodies) ||
+            !list_copy(state.static_free, snapshot->static_free))
+            return false;
+        state.static_version = snapshot->static_version;
+        state.static_tree_dirty = true;
+    }
+    state.gravity = snapshot->gravity;
+    state.terminal_velocity = snapshot->terminal_velocity;
+    state.accumulator = snapshot->accumulator;
+    state.event_queue.head = 0;
+    state.event_queue.len = 0;
+    state.static_wakes->len = 0;
+    state.query_tree_dirty = true;
+    return true;
 }
 
 uint64 physics_body_create(Body_data *data, On_hit on_hit, On_static_hit on_static_hit) {
-    uint64 id = state.body_list->len;
-
-    for (uint64 i = 0; i < state.body_list->len; i++) {
-        Body *body = physics_body_get(i);
-        // to use inactive objects first
-        if (!body->active) {
-            id = i;
-            break;
+    return body_create(data, on_hit, on_static_hit, data->kinematic ? BODY_MOTION_KINEMATIC : BODY_MOTION_DYNAMIC);
+}
+
+// the body joins the partition of its motion type
+static uint64 body_create(Body_data *data, On_hit on_hit, On_static_hit on_static_hit, Body_motion motion) {
+    Body_store *store = &state.store;
+    // slots of destroyed bodies first
+    uint64 handle = slot_map_alloc(&state.body_slots);
+    if (handle == -1) return -1;
+    uint64 id = SLOT_HANDLE_INDEX(handle);
+
+    if (id == store->len) {
+        uint64 capacity = store->capacity;
+        Body *view = body_store_reserve(store, id + 1) ? array_Body_emplace_back(&state.body_list) : NULL;
+        if (!view) {
+            slot_map_release(&state.body_slots, handle);
+            ERROR_RETURN(-1, "Cannot append item to physics body_list\n");
         }
+        *view = (Body){0};
+        store->len++;
+        // the store arrays moved, every view has to point into the new ones
+        if (capacity != store->capacity) body_views_update();
     }
 
-    if (id == state.body_list->len) {
-        uint64 body_id = list_append(state.body_list, &(Body){0});
-        ASSERT_RETURN(body_id != -1, -1, "Cannot append item to physics body_list\n");
-    }
-    Body *body = physics_body_get(id);
+    store->pos[id][0] = data->pos[0];
+    store->pos[id][1] = data->pos[1];
+    store->start_pos[id][0] = data->pos[0];
+    store->start_pos[id][1] = data->pos[1];
+    store->half_size[id][0] = data->size[0] * 0.5;
+    store->half_size[id][1] = data->size[1] * 0.5;
+    store->velocity[id][0] = data->velocity[0];
+    store->velocity[id][1] = data->velocity[1];
+    store->acceleration[id][0] = 0;
+    store->acceleration[id][1] = 0;
+    store->collision_layer[id] = data->collision_layer;
+    store->collision_mask[id] = data->collision_mask;
+    store->flags[id] = BODY_FLAG_ACTIVE | (data->contact_stay ? BODY_FLAG_CONTACT_STAY : 0) |
+                       (data->never_sleep ? BODY_FLAG_NEVER_SLEEP : 0);
+    store->sleep_ticks[id] = 0;
+    body_store_partition_add(store, (uint32) id, motion);
+    state.query_tree_dirty = true;
+    state.views_version = ++state.version_counter;
+    state.layout_version = state.views_version;
+
+    Body *body = physics_body_at(id);
     *body = (Body){
-        .aabb = {
-            .pos = { data->pos[0], data->pos[1] },
-            .half_size = { data->size[0] * 0.5, data->size[1] * 0.5 }
-        },
-        .velocity = { data->velocity[0], data->velocity[1] }, .acceleration = { 0, 0 },
-        .collision_layer = data->collision_layer, .collision_mask = data->collision_mask,
+        .pos = store->pos[id], .half_size = store->half_size[id],
+        .velocity = store->velocity[id], .acceleration = store->acceleration[id],
         .on_hit = on_hit, .on_static_hit = on_static_hit,
-        .active = true, .kinematic = data->kinematic,
-        .entity_id = -1
+        .id = id, .entity_id = -1
     };
-    return id;
+    return handle;
+}
+
+// stale handles are ignored
+void physics_body_destroy(uint64 handle) {
+    if (!slot_map_valid(&state.body_slots, handle)) return;
+    uint32 index = SLOT_HANDLE_INDEX(handle);
+    if (state.dispatching) {
+        // queued events can still name this body, the slot is not reused until they are gone
+        if (state.store.flags[index] & BODY_FLAG_DESTROY_PENDING) return;
+        state.store.flags[index] |= BODY_FLAG_DESTROY_PENDING;
+        list_append(state.pending_destroys, &index);
+        state.query_tree_dirty = true;
+        return;
+    }
+    body_destroy(index);
+}
+
+static void body_destroy(uint32 index) {
+    slot_map_release(&state.body_slots, slot_map_handle(&state.body_slots, index));
+    if (state.store.flags[index] & BODY_FLAG_ACTIVE)
+        body_store_partition_remove(&state.store, (uint32) index);
+    state.store.flags[index] &= ~(BODY_FLAG_ACTIVE | BODY_FLAG_DESTROY_PENDING);
+    state.query_tree_dirty = true;
+    state.layout_version = ++state.version_counter;
+
+    // the contacts end without exit events, a new body in this slot starts with none
+    Contact_pair *contacts = state.contacts->items;
+    uint64 kept = 0;
+    for (uint64 i = 0; i < state.contacts->len; i++) {
+        if (contacts[i].self_id != index && contacts[i].other_id != index)
+            contacts[kept++] = contacts[i];
+    }
+    state.contacts->len = kept;
 }
 
-uint64 physics_trigger_create(vec2 position, vec2 size, uint8 collision_layer, uint8 collision_mask, On_hit on_hit) {
+uint64 physics_trigger_create(vec2 position, vec2 size, uint32 collision_layer, uint32 collision_mask, On_hit on_hit) {
     Body_data data = {
         .pos = {position[0], position[1]}, .size = {size[0], size[1]},
         .velocity = {0, 0},
@@ -102,51 +727,163 @@ uint64 physics_trigger_create(vec2 position, vec2 size, uint8 collision_layer, u
         .kinematic = true
     };
 
-    return physics_body_create(&data, on_hit, NULL);
+    return body_create(&data, on_hit, NULL, BODY_MOTION_TRIGGER);
+}
+
+// NULL once the body of the handle is destroyed
+Body *physics_body_get(uint64 handle) {
+    if (!slot_map_valid(&state.body_slots, handle)) return NULL;
+    return array_Body_at(&state.body_list, SLOT_HANDLE_INDEX(handle));
 }
 
-Body *physics_body_get(uint64 index) {
-    Body *body = (Body *)list_get(state.body_list, index);
-    ASSERT_RETURN(body, NULL, "Cannot access body in body list\n");
-    return body;
+// body of the slot with this index whether it is in use or not, for walking every body
+// and for the ids of collisions and queries
+Body *physics_body_at(uint64 index) {
+    return array_Body_at(&state.body_list, index);
+}
+
+uint64 physics_body_handle(Body *body) {
+    return slot_map_handle(&state.body_slots, body->id);
+}
+
+bool physics_body_valid(uint64 handle) {
+    return slot_map_valid(&state.body_slots, handle);
+}
+
+bool physics_body_is_active(Body *body) {
+    return state.store.flags[body->id] & BODY_FLAG_ACTIVE;
+}
+
+bool physics_body_is_sleeping(Body *body) {
+    return state.store.flags[body->id] & BODY_FLAG_SLEEPING;
+}
+
+void physics_body_wake(uint64 handle) {
+    if (slot_map_valid(&state.body_slots, handle))
+        body_wake(SLOT_HANDLE_INDEX(handle));
+}
+
+static void body_wake(uint32 index) {
+    state.store.flags[index] &= ~BODY_FLAG_SLEEPING;
+    state.store.sleep_ticks[index] = 0;
+}
+
+uint32 physics_body_layer(Body *body) {
+    return state.store.collision_layer[body->id];
+}
+
+AABB physics_body_aabb(Body *body) {
+    return body_aabb(body->id);
+}
+
+// position of the body between the last two steps, see physics_alpha
+void physics_body_interpolate(Body *body, vec2 result) {
+    float32 alpha = physics_alpha();
+    float32 *start = state.store.start_pos[body->id], *pos = state.store.pos[body->id];
+    result[0] = start[0] + (pos[0] - start[0]) * alpha;
+    result[1] = start[1] + (pos[1] - start[1]) * alpha;
+}
+
+// mask of the frame drawn for the body, centered on the body moved by offset like the sprite,
+// NULL goes back to plain box contacts
+void physics_body_pixel_mask_set(uint64 handle, Pixel_mask *mask, vec2 offset, bool flipped) {
+    Body *body = physics_body_get(handle);
+    if (!body) return;
+    body->pixel_mask = mask;
+    body->mask_offset[0] = mask ? offset[0] : 0;
+    body->mask_offset[1] = mask ? offset[1] : 0;
+    body->mask_flipped = flipped;
 }
 
 uint64 physics_static_body_create(Body_data data) {
-    // no inactive body selection since static bodies don't get destroyed
     Static_body static_body = {
         .aabb = {
             .pos = { data.pos[0], data.pos[1] },
             .half_size = { data.size[0] * 0.5, data.size[1] * 0.5 },
         },
-        .collision_layer = data.collision_layer
+        .collision_layer = data.collision_layer,
+        .active = true
     };
-    uint64 static_body_id = list_append(state.static_body_list, &static_body);
-    ASSERT_RETURN(static_body_id != -1, -1, "Cannot append item to physics static_body_list\n");
+    state.static_version = ++state.version_counter;
+
+    // slots of destroyed static bodies first, a slot still in the tree only refits it
+    if (state.static_free->len > 0) {
+        uint32 static_body_id = ((uint32 *) state.static_free->items)[--state.static_free->len];
+        *array_Static_body_at(&state.static_body_list, static_body_id) = static_body;
+        static_tree_refit(static_body_id, &static_body.aabb);
+        return static_body_id;
+    }
+    uint64 static_body_id = state.static_body_list.len;
+    Static_body *slot = array_Static_body_emplace_back(&state.static_body_list);
+    ASSERT_RETURN(slot, -1, "Cannot append item to physics static_body_list\n");
+    *slot = static_body;
+    state.static_tree_dirty = true;
 
     return static_body_id;
 }
 
+// static hits already queued still name the slot
+void physics_static_body_destroy(uint64 index) {
+    Static_body *static_body = physics_static_body_get(index);
+    if (!static_body || !static_body->active) return;
+    // sleeping bodies get no gravity, the ones resting on it have to fall again
+    list_append(state.static_wakes, &static_body->aabb);
+    static_body->active = false;
+    uint32 id = (uint32) index;
+    list_append(state.static_free, &id);
+    static_tree_refit(id, NULL);
+    state.static_version = ++state.version_counter;
+}
+
+// builds the static body tree, call once the level is set up
+// physics_update rebuilds it when static bodies are created in new slots after this, reused slots are refit
+void physics_static_bake(void) {
+    aabb_tree_clear(&state.static_tree);
+    for (uint64 i = 0; i < state.static_body_list.len; i++) {
+        Static_body *static_body = array_Static_body_at(&state.static_body_list, i);
+        if (!static_body->active) continue;
+        vec2 min, max;
+        aabb_min_max(min, max, &static_body->aabb);
+        aabb_tree_insert(&state.static_tree, i, min, max);
+    }
+    aabb_tree_build(&state.static_tree);
+    state.static_tree_dirty = false;
+}
+
+// NULL for an index past the last static body, the hot paths inside physics use array_Static_body_at instead
 Static_body *physics_static_body_get(uint64 index) {
-    Static_body *static_body = (Static_body *)list_get(state.static_body_list, index);
-    ASSERT_RETURN(static_body, NULL, "Cannot access static_body in static_body list\n");
-    return static_body;
+    if (index >= state.static_body_list.len) {
+        ERROR_RETURN(NULL, "Cannot access static_body in static_body list\n");
+    }
+    return array_Static_body_at(&state.static_body_list, index);
 }
 
 bool physics_point_intersect(vec2 point, AABB *aabb) {
+#ifdef PHYSICS_FIXED_POINT
+    return fixed_point_intersect(point, aabb);
+#else
     vec2 min, max;
     aabb_min_max(min, max, aabb);
     return point[0] >= min[0] && point[0] <= max[0] &&
            point[1] >= min[1] && point[1] <= max[1];
+#endif
 }
 
 bool physics_aabb_intersect(AABB *a, AABB *b) {
+#ifdef PHYSICS_FIXED_POINT
+    return fixed_aabb_intersect(a, b);
+#else
     vec2 min, max;
     AABB diff = minkowsky_diff_aabb(a, b);
     aabb_min_max(min, max, &diff);
     return (min[0] <= 0 && max[0] >= 0 && min[1] <= 0 && max[1] >= 0);
+#endif
 }
 
 Collision ray_collide_aabb(vec2 pos, vec2 magnitude, AABB aabb) {
+#ifdef PHYSICS_FIXED_POINT
+    return fixed_ray_collide_aabb(pos, magnitude, aabb);
+#else
     Collision result = {0};
     vec2 min, max;
     float32 last_entry = -INFINITY, first_exit = INFINITY;
@@ -187,16 +924,24 @@ Collision ray_collide_aabb(vec2 pos, vec2 magnitude, AABB aabb) {
 
     }
     return result;
+#endif
 }
 
 AABB minkowsky_diff_aabb(AABB *a, AABB *b) {
+#ifdef PHYSICS_FIXED_POINT
+    return fixed_minkowsky_diff_aabb(a, b);
+#else
     AABB diff;
     vec2_sub(diff.pos, a->pos, b->pos);
     vec2_add(diff.half_size, a->half_size, b->half_size);
     return diff;
+#endif
 }
 
 void minkowsky_diff_pen_vector(vec2 result, AABB *minkowsky_aabb) {
+#ifdef PHYSICS_FIXED_POINT
+    fixed_minkowsky_diff_pen_vector(result, minkowsky_aabb);
+#else
     vec2 min, max;
     aabb_min_max(min, max, minkowsky_aabb);
 
@@ -221,18 +966,1136 @@ void minkowsky_diff_pen_vector(vec2 result, AABB *minkowsky_aabb) {
         result[0] = 0;
         result[1] = max[1];
     }
+#endif
 }
 
 void aabb_min_max(vec2 min, vec2 max, AABB *aabb) {
+#ifdef PHYSICS_FIXED_POINT
+    fixed_aabb_min_max(min, max, aabb);
+#else
     vec2_sub(min, aabb->pos, aabb->half_size);
     vec2_add(max, aabb->pos, aabb->half_size);
+#endif
+}
+
+static void body_views_update(void) {
+    Body *bodies = state.body_list.items;
+    for (uint64 i = 0; i < state.body_list.len; i++) {
+        bodies[i].pos = state.store.pos[i];
+        bodies[i].half_size = state.store.half_size[i];
+        bodies[i].velocity = state.store.velocity[i];
+        bodies[i].acceleration = state.store.acceleration[i];
+    }
+}
+
+// the views of a snapshot without their pixel masks, which change every frame and are not saved,
+// a body keeps the mask it has and one which had no view yet gets none
+static bool body_views_restore(Array_Body *views) {
+    uint64 len = state.body_list.len;
+    if (!array_Body_reserve(&state.body_list, views->len)) return false;
+    Body *bodies = state.body_list.items, *saved = views->items;
+    for (uint64 i = 0; i < views->len; i++) {
+        Body view = saved[i];
+        view.pixel_mask = (i < len) ? bodies[i].pixel_mask : NULL;
+        view.mask_offset[0] = (i < len) ? bodies[i].mask_offset[0] : 0;
+        view.mask_offset[1] = (i < len) ? bodies[i].mask_offset[1] : 0;
+        view.mask_flipped = (i < len) && bodies[i].mask_flipped;
+        bodies[i] = view;
+    }
+    state.body_list.len = views->len;
+    return true;
+}
+
+static void snapshot_free(Physics_snapshot *snapshot) {
+    body_store_free(&snapshot->store);
+    slot_map_free(&snapshot->body_slots);
+    list_delete(snapshot->contacts);
+    array_Body_free(&snapshot->body_views);
+    array_Static_body_free(&snapshot->static_bodies);
+    list_delete(snapshot->static_free);
+}
+
+static void query_trees_update(void) {
+    if (state.static_tree_dirty)
+        physics_static_bake();
+    if (!state.query_tree_dirty) return;
+
+    aabb_tree_clear(&state.query_tree);
+    for (uint64 i = 0; i < state.store.len; i++) {
+        if ((state.store.flags[i] & (BODY_FLAG_ACTIVE | BODY_FLAG_DESTROY_PENDING)) != BODY_FLAG_ACTIVE) continue;
+        vec2 min, max;
+        AABB aabb = body_aabb(i);
+        aabb_min_max(min, max, &aabb);
+        aabb_tree_insert(&state.query_tree, (uint32) i, min, max);
+    }
+    aabb_tree_build(&state.query_tree);
+    state.query_tree_dirty = false;
+}
+
+// moves a static body slot of the baked tree to aabb or removes it for NULL, the tree is only
+// rebuilt by the next step or query when the slot was not baked into it, a level edited by chunks
+// reuses the slots it just freed so only the leaves of those slots and the nodes above them change
+static void static_tree_refit(uint32 index, AABB *aabb) {
+    if (state.static_tree_dirty || !aabb_tree_contains(&state.static_tree, index)) {
+        state.static_tree_dirty = true;
+        return;
+    }
+    if (!aabb) {
+        aabb_tree_remove(&state.static_tree, index);
+        return;
+    }
+    vec2 min, max;
+    aabb_min_max(min, max, aabb);
+    aabb_tree_update(&state.static_tree, index, min, max);
+}
+
+// wakes the sleeping bodies touching a static body destroyed since the last step, grown by STATIC_WAKE_MARGIN,
+// one pass over the bodies for all of them instead of a query tree rebuild for each
+static void static_wakes_flush(void) {
+    if (state.static_wakes->len == 0) return;
+    AABB *wakes = state.static_wakes->items;
+    for (uint64 i = 0; i < state.store.len; i++) {
+        if (!(state.store.flags[i] & BODY_FLAG_SLEEPING)) continue;
+        AABB aabb = body_aabb(i);
+        for (uint64 w = 0; w < state.static_wakes->len; w++) {
+            if (fabsf(aabb.pos[0] - wakes[w].pos[0]) <= aabb.half_size[0] + wakes[w].half_size[0] + STATIC_WAKE_MARGIN &&
+                fabsf(aabb.pos[1] - wakes[w].pos[1]) <= aabb.half_size[1] + wakes[w].half_size[1] + STATIC_WAKE_MARGIN) {
+                body_wake((uint32) i);
+                break;
+            }
+        }
+    }
+    state.static_wakes->len = 0;
+}
+
+// point is NULL for box queries, the tree only finds candidates for the exact test
+static uint64 query_collect(AABB *aabb, vec2 point, uint32 collision_mask, Physics_query_hit *hits, uint64 max_hits) {
+    query_trees_update();
+    uint64 count = 0, mark;
+    vec2 min, max;
+    aabb_min_max(min, max, aabb);
+    Arena *arena = query_scratch_begin(&mark);
+
+    state.query_items->len = 0;
+    aabb_tree_query(&state.query_tree, min, max, state.query_stack, state.query_items);
+    uint32 *items = state.query_items->items;
+    for (uint64 i = 0; i < state.query_items->len && count < max_hits; i++) {
+        uint32 id = items[i];
+        if (!(state.store.collision_layer[id] & collision_mask)) continue;
+        AABB other = body_aabb(id);
+        bool overlap = point ? physics_point_intersect(point, &other) : physics_aabb_intersect(aabb, &other);
+        if (overlap) hits[count++] = (Physics_query_hit){ .id = id, .is_static = false };
+    }
+
+    state.query_items->len = 0;
+    aabb_tree_query(&state.static_tree, min, max, state.query_stack, state.query_items);
+    items = state.query_items->items;
+    for (uint64 i = 0; i < state.query_items->len && count < max_hits; i++) {
+        Static_body *static_body = array_Static_body_at(&state.static_body_list, items[i]);
+        if (!(static_body->collision_layer & collision_mask)) continue;
+        bool overlap = point ? physics_point_intersect(point, &static_body->aabb) : physics_aabb_intersect(aabb, &static_body->aabb);
+        if (overlap) hits[count++] = (Physics_query_hit){ .id = items[i], .is_static = true };
+    }
+    query_scratch_end(arena, mark);
+    return count;
+}
+
+// the query lists take their items from the frame arena of the calling thread until query_scratch_end,
+// NULL and the lists stay on the heap without frame arenas
+static Arena *query_scratch_begin(uint64 *mark) {
+    Arena *arena = frame_arena_worker(0);
+    if (!arena) return NULL;
+    *mark = arena->used;
+    list_arena_set(state.query_stack, arena);
+    list_arena_set(state.query_items, arena);
+    return arena;
+}
+
+static void query_scratch_end(Arena *arena, uint64 mark) {
+    if (!arena) return;
+    list_arena_set(state.query_stack, NULL);
+    list_arena_set(state.query_items, NULL);
+    arena_reset_to(arena, mark);
+}
+
+static bool query_ray_hit(Physics_query_hit *hit, vec2 origin, vec2 magnitude, AABB aabb) {
+    Collision collision = ray_collide_aabb(origin, magnitude, aabb);
+    if (!collision.collided) return false;
+
+    // ray_collide_aabb gives a negative time when the ray starts inside the box
+    if (collision.time < 0) {
+        hit->time = 0;
+        hit->pos[0] = origin[0];
+        hit->pos[1] = origin[1];
+        hit->normal[0] = hit->normal[1] = 0;
+        return true;
+    }
+    hit->time = collision.time;
+    hit->pos[0] = collision.pos[0];
+    hit->pos[1] = collision.pos[1];
+    hit->normal[0] = collision.normal[0];
+    hit->normal[1] = collision.normal[1];
+    return true;
+}
+
+// insertion into hits sorted by time, the farthest hit drops out once max_hits are kept
+static uint64 query_hit_insert(Physics_query_hit *hits, uint64 count, uint64 max_hits, Physics_query_hit *hit) {
+    uint64 i = count;
+    if (i == max_hits) {
+        if (hits[i - 1].time <= hit->time) return count;
+        i--;
+    }
+    else {
+        count++;
+    }
+    for (; i > 0 && hits[i - 1].time > hit->time; i--)
+        hits[i] = hits[i - 1];
+    hits[i] = *hit;
+    return count;
+}
+
+// puts bodies which stayed at rest for SLEEP_TICKS steps to sleep
+// wakes sleeping bodies whose velocity, acceleration or position was written since the last step
+// fills the step ids with the bodies which stay awake, one group for every motion type
+static void sleep_update(void) {
+    Body_store *store = &state.store;
+    state.step_ids->len = 0;
+    for (uint32 motion = 0; motion < BODY_MOTION_COUNT; motion++) {
+        state.step_ranges[motion] = state.step_ids->len;
+        List *partition = store->partitions[motion];
+        uint32 *ids = partition->items;
+        for (uint64 p = 0; p < partition->len; p++) {
+            uint32 i = ids[p];
+            if (body_sleep_update(i)) list_append(state.step_ids, &i);
+        }
+    }
+    state.step_ranges[BODY_MOTION_COUNT] = state.step_ids->len;
+}
+
+// returns true if the body is awake for this step
+static bool body_sleep_update(uint32 body_id) {
+    Body_store *store = &state.store;
+    float32 *velocity = store->velocity[body_id], *acceleration = store->acceleration[body_id];
+    float32 moved_x = store->pos[body_id][0] - store->start_pos[body_id][0];
+    float32 moved_y = store->pos[body_id][1] - store->start_pos[body_id][1];
+
+    if (store->flags[body_id] & BODY_FLAG_SLEEPING) {
+        if (velocity[0] != 0 || velocity[1] != 0 || acceleration[0] != 0 || acceleration[1] != 0 ||
+            moved_x != 0 || moved_y != 0) {
+            body_wake(body_id);
+            state.stats.awake_bodies++;
+            return true;
+        }
+        state.stats.sleeping_bodies++;
+        return false;
+    }
+
+    bool at_rest = fabsf(velocity[0]) < SLEEP_VELOCITY && fabsf(velocity[1]) < SLEEP_VELOCITY &&
+                   fabsf(moved_x) < SLEEP_DISTANCE && fabsf(moved_y) < SLEEP_DISTANCE &&
+                   acceleration[0] == 0 && acceleration[1] == 0;
+    if (!at_rest) {
+        store->sleep_ticks[body_id] = 0;
+        state.stats.awake_bodies++;
+        return true;
+    }
+    // never_sleep bodies stop counting at SLEEP_TICKS but still count as at rest for wake_touched
+    if (store->sleep_ticks[body_id] < SLEEP_TICKS) store->sleep_ticks[body_id]++;
+    if (store->sleep_ticks[body_id] < SLEEP_TICKS || (store->flags[body_id] & BODY_FLAG_NEVER_SLEEP)) {
+        state.stats.awake_bodies++;
+        return true;
+    }
+    store->flags[body_id] |= BODY_FLAG_SLEEPING;
+    velocity[0] = 0;
+    velocity[1] = 0;
+    state.stats.sleeping_bodies++;
+    return false;
+}
+
+// sleeping bodies which the swept bounds of an awake body reach are woken if either of them can collide with the other
+// a body at rest does not wake its neighbours, else two resting bodies in contact keep each other awake
+static void wake_touched(Physics_worker *worker, uint64 body_id) {
+    Body_store *store = &state.store;
+    if (store->sleep_ticks[body_id] > 0) return;
+    uint32 *candidates = worker->candidates->items;
+    for (uint64 c = 0; c < worker->candidates->len; c++) {
+        uint32 i = candidates[c];
+        if (!(store->flags[i] & BODY_FLAG_SLEEPING)) continue;
+        if (!(store->collision_mask[i] & store->collision_layer[body_id]) &&
+            !(store->collision_mask[body_id] & store->collision_layer[i]))
+            continue;
+        list_append(worker->wakes, &i);
+    }
+}
+
+// one scratch context for every thread which can take part in the step
+// one pass for every half size the body moves this step, so slow bodies take a single pass and the
+// slide after a hit never carries a fast body further than half its size into terrain
+static uint32 body_substeps(uint64 body_id) {
+    float32 *velocity = state.store.velocity[body_id], *half_size = state.store.half_size[body_id];
+    float32 travel = fmaxf(fabsf(velocity[0]), fabsf(velocity[1])) * state.step_delta;
+    float32 half = fminf(half_size[0], half_size[1]);
+    if (travel <= half) return 1;
+    if (half <= 0 || travel >= half * PHYSICS_SUBSTEPS_MAX) return PHYSICS_SUBSTEPS_MAX;
+    return (uint32) ceilf(travel / half);
+}
+
+static void workers_update(void) {
+    while (state.workers.len < workers_count()) {
+        Physics_worker worker = {
+            .candidates = list_create(0, sizeof(uint32)),
+            .static_candidates = list_create(0, sizeof(uint32)),
+            .tree_stack = list_create(0, sizeof(uint32)),
+            .events = list_create(0, sizeof(Collision_event)),
+            .contacts = list_create(0, sizeof(Collision_event)),
+            .wakes = list_create(0, sizeof(uint32)),
+            .speculative = list_create(0, sizeof(Speculative_contact))
+        };
+        Physics_worker *slot = array_Physics_worker_emplace_back(&state.workers);
+        if (!slot) {
+            ERROR_EXIT_PROGRAM("Unable to allocate memory for physics workers\n");
+        }
+        *slot = worker;
+    }
+    // a worker index has the same arena on every thread that runs it, and nothing else of the frame is
+    // allocated from the arenas until the step gives its part back
+    for (uint64 i = 0; i < state.workers.len; i++) {
+        Physics_worker *worker = array_Physics_worker_at(&state.workers, i);
+        worker->arena = frame_arena_worker((uint32) i);
+        if (worker->arena) worker->arena_mark = worker->arena->used;
+        worker_arena_set(worker, worker->arena);
+        worker->stats = (Physics_stats){0};
+    }
+}
+
+// takes the lists out of the frame arenas before the step gives the arenas back
+static void workers_release(void) {
+    for (uint64 i = 0; i < state.workers.len; i++) {
+        Physics_worker *worker = array_Physics_worker_at(&state.workers, i);
+        if (!worker->arena) continue;
+        worker_arena_set(worker, NULL);
+        arena_reset_to(worker->arena, worker->arena_mark);
+        worker->arena = NULL;
+    }
+}
+
+// empties every scratch list of the worker, which takes its items from arena from now on
+static void worker_arena_set(Physics_worker *worker, Arena *arena) {
+    List *lists[] = {
+        worker->candidates, worker->static_candidates, worker->tree_stack,
+        worker->events, worker->contacts, worker->wakes, worker->speculative
+    };
+    for (uint32 l = 0; l < sizeof(lists) / sizeof(lists[0]); l++)
+        list_arena_set(lists[l], arena);
+}
+
+static void step_chunk(void *data, uint32 worker_index, uint64 chunk) {
+    Physics_worker *worker = array_Physics_worker_at(&state.workers, worker_index);
+    Physics_event_range *range = array_Physics_event_range_at(&state.event_ranges, chunk);
+    range->worker = worker_index;
+    range->begin = worker->events->len;
+    range->contact_begin = worker->contacts->len;
+
+    // a chunk can reach into the next motion type, each group of it runs its own loop
+    static void (*const step_motion[PHYSICS_SOLVER_COUNT][BODY_MOTION_COUNT])(Physics_worker *, uint32 *, uint64) = {
+        [PHYSICS_SOLVER_SWEEP] = {
+            [BODY_MOTION_DYNAMIC] = step_bodies, [BODY_MOTION_KINEMATIC] = step_bodies,
+            [BODY_MOTION_TRIGGER] = step_triggers
+        },
+        [PHYSICS_SOLVER_SPECULATIVE] = {
+            [BODY_MOTION_DYNAMIC] = step_bodies_speculative, [BODY_MOTION_KINEMATIC] = step_bodies_speculative,
+            [BODY_MOTION_TRIGGER] = step_triggers
+        }
+    };
+    uint32 *ids = state.step_ids->items;
+    uint64 begin = chunk * STEP_CHUNK_SIZE, end = begin + STEP_CHUNK_SIZE;
+    for (uint32 motion = 0; motion < BODY_MOTION_COUNT; motion++) {
+        uint64 group_begin = state.step_ranges[motion], group_end = state.step_ranges[motion + 1];
+        if (group_begin < begin) group_begin = begin;
+        if (group_end > end) group_end = end;
+        if (group_begin < group_end)
+            step_motion[state.solver][motion](worker, &ids[group_begin], group_end - group_begin);
+    }
+    range->end = worker->events->len;
+    range->contact_end = worker->contacts->len;
+}
+
+// swept against static bodies and bodies, pushed out of static bodies
+static void step_bodies(Physics_worker *worker, uint32 *ids, uint64 count) {
+    for (uint64 b = 0; b < count; b++) {
+        uint32 i = ids[b];
+        // same candidates for every iteration since they are found with the bounds of the whole tick
+        broadphase_query(worker, i, false);
+        uint64 contact_begin = worker->contacts->len;
+        worker->stats.pairs_tested += worker->candidates->len;
+        worker->stats.pairs_culled += state.stats.active_bodies - 1 - worker->candidates->len;
+
+        // scale velocity with delta time to use in calculations
+        uint32 substeps = body_substeps(i);
+        worker->stats.substeps[substeps - 1]++;
+        vec2 distance;
+#ifdef PHYSICS_FIXED_POINT
+        fixed_vec2_scale(distance, state.store.velocity[i], state.step_delta, substeps);
+#else
+        vec2_scale(distance, state.store.velocity[i], state.step_delta / substeps);
+#endif
+        // one sweep response and one stationary response for each substep
+        for (uint32 j = 0; j < substeps; j++) {
+            sweep_response(worker, i, distance);
+            stationary_response(worker, i);
+        }
+        contacts_unique(worker->contacts, contact_begin);
+        wake_touched(worker, i);
+    }
+}
+
+// triggers move without being stopped and only report the bodies they overlap at the end of the step
+static void step_triggers(Physics_worker *worker, uint32 *ids, uint64 count) {
+    Body_store *store = &state.store;
+    for (uint64 b = 0; b < count; b++) {
+        uint32 i = ids[b];
+        vec2 min, max, distance;
+        swept_bounds(min, max, i);
+        broadphase_query_bodies(worker, i, min, max, false);
+        uint64 contact_begin = worker->contacts->len;
+        worker->stats.pairs_tested += worker->candidates->len;
+        worker->stats.pairs_culled += state.stats.active_bodies - 1 - worker->candidates->len;
+        worker->stats.substeps[0]++;
+
+#ifdef PHYSICS_FIXED_POINT
+        fixed_vec2_scale(distance, store->velocity[i], state.step_delta, 1);
+#else
+        vec2_scale(distance, store->velocity[i], state.step_delta);
+#endif
+        step_vec2_add(store->pos[i], store->pos[i], distance);
+
+        uint32 *candidates = worker->candidates->items;
+        for (uint64 c = 0; c < worker->candidates->len; c++) {
+            uint32 other_id = candidates[c];
+            if (!(store->collision_mask[i] & store->collision_layer[other_id])) continue;
+            AABB trigger = body_aabb(i), other = body_start_aabb(other_id);
+            if (physics_aabb_intersect(&other, &trigger))
+                contact_touch(worker, i, other_id, &(Collision){.collided = true, .other_id = other_id});
+        }
+        contacts_unique(worker->contacts, contact_begin);
+        wake_touched(worker, i);
+    }
+}
+
+// the static bodies around the swept bounds are gathered once, then the whole move of the tick is resolved
+// against them one axis at a time without substeps, ending where the sweep of its substeps ends
+// a stop sends a static hit for every static body the body stops against, a move along the side of a static body
+// the body presses into sends one for every static body of that side it passes, each once per step
+static void step_bodies_speculative(Physics_worker *worker, uint32 *ids, uint64 count) {
+    Body_store *store = &state.store;
+    for (uint64 b = 0; b < count; b++) {
+        uint32 i = ids[b];
+        broadphase_query(worker, i, false);
+        uint64 contact_begin = worker->contacts->len;
+        worker->stats.pairs_tested += worker->candidates->len;
+        worker->stats.pairs_culled += state.stats.active_bodies - 1 - worker->candidates->len;
+        worker->stats.substeps[0]++;
+
+        Speculative_move move = {.body_id = i, .substeps = body_substeps(i), .event_begin = worker->events->len};
+#ifdef PHYSICS_FIXED_POINT
+        fixed_vec2_scale(move.distance, store->velocity[i], state.step_delta, 1);
+#else
+        vec2_scale(move.distance, store->velocity[i], state.step_delta);
+#endif
+        speculative_contacts(worker, i);
+        float32 *pos = store->pos[i], *distance = move.distance;
+        vec2 start = {pos[0], pos[1]};
+        vec2_dup(move.path[0], start);
+        Collision hit = speculative_first_hit(worker, &move);
+        // free the whole way, the corner an axis at a time could cut is not in the way
+        if (!hit.collided) {
+            step_vec2_add(pos, pos, distance);
+            vec2_dup(move.path[1], ((vec2){pos[0], start[1]}));
+            vec2_dup(move.path[2], pos);
+            move.path_axis[0] = 0;
+            move.path_axis[1] = 1;
+            move.path_len = 2;
+        }
+        else {
+            // like the sweep the axis along the side goes up to where the body runs into the side, the other one
+            // stops there and the axis along the side goes on with the slide of the substep the stop comes in
+            uint8 stop = hit.normal[1] != 0, along = !stop;
+            float32 part = hit.pos[along] - start[along], slide = 0;
+            bool along_stopped = speculative_solve_axis(worker, &move, along, part, 0);
+            bool stopped = speculative_solve_axis(worker, &move, stop, distance[stop], 0);
+            if (stopped)
+                slide = speculative_slide(distance[along], distance[stop], start[stop], pos[stop], move.substeps);
+            // the slide can take the body past the bounds the candidates were found with
+            if (slide != 0 && broadphase_refit(worker, i))
+                speculative_contacts(worker, i);
+            if (!along_stopped)
+                speculative_solve_axis(worker, &move, along, distance[along] - part, slide);
+
+            // the stopped axis goes on once the other one left the sides it stopped against
+            float32 along_from = start[along] + slide, clear;
+            if (stopped && speculative_side_end(worker, &move, stop, pos[stop], along_from, pos[along], &clear)) {
+                float32 travel = speculative_resume(distance[stop], start[stop], pos[stop], distance[along], along_from,
+                                                    clear, move.substeps);
+                speculative_solve_axis(worker, &move, stop, travel, 0);
+            }
+        }
+
+        speculative_touch_bodies(worker, &move);
+        contacts_unique(worker->contacts, contact_begin);
+        wake_touched(worker, i);
+    }
+}
+
+// grows the static candidates by the half size of the body and pushes the body out of the ones it starts in
+static void speculative_contacts(Physics_worker *worker, uint64 body_id) {
+    Body_store *store = &state.store;
+    worker->speculative->len = 0;
+    uint32 *static_candidates = worker->static_candidates->items;
+    for (uint64 c = 0; c < worker->static_candidates->len; c++) {
+        Static_body *static_body = array_Static_body_at(&state.static_body_list, static_candidates[c]);
+        if (!(store->collision_mask[body_id] & static_body->collision_layer)) continue;
+
+        AABB grown = static_body->aabb;
+        step_vec2_add(grown.half_size, grown.half_size, store->half_size[body_id]);
+        Speculative_contact contact = {.static_id = static_candidates[c], .grown = grown};
+        aabb_min_max(contact.min, contact.max, &grown);
+        list_append(worker->speculative, &contact);
+    }
+
+    // out through the nearest side, the position is set to the side itself so it is exact in both builds
+    float32 *pos = store->pos[body_id];
+    Speculative_contact *contacts = worker->speculative->items;
+    for (uint64 c = 0; c < worker->speculative->len; c++) {
+        Speculative_contact *contact = &contacts[c];
+        if (pos[0] <= contact->min[0] || pos[0] >= contact->max[0] ||
+            pos[1] <= contact->min[1] || pos[1] >= contact->max[1])
+            continue;
+
+        float32 nearest = INFINITY, side = 0;
+        uint8 axis = 0;
+        for (uint8 a = 0; a < 2; a++) {
+            if (pos[a] - contact->min[a] < nearest) {
+                nearest = pos[a] - contact->min[a];
+                side = contact->min[a];
+                axis = a;
+            }
+            if (contact->max[a] - pos[a] < nearest) {
+                nearest = contact->max[a] - pos[a];
+                side = contact->max[a];
+                axis = a;
+            }
+        }
+        pos[axis] = side;
+    }
+}
+
+// the side the sweep stops against first, the nearest one on the way of the whole step with the one of the
+// faster axis first at the same time
+static Collision speculative_first_hit(Physics_worker *worker, Speculative_move *move) {
+    float32 *pos = state.store.pos[move->body_id];
+    Collision nearest = {.time = INFINITY};
+    Speculative_contact *contacts = worker->speculative->items;
+    for (uint64 c = 0; c < worker->speculative->len; c++) {
+        Collision hit = ray_collide_aabb(pos, move->distance, contacts[c].grown);
+        if (hit.collided) update_sweep_result(&nearest, &hit, contacts[c].static_id, move->distance);
+    }
+    return nearest;
+}
+
+// moves the body along one axis by travel and extra up to the nearest grown static body in the way,
+// static bodies the body only slides along are not in the way, returns true when it stops
+// the static hits are sent for the stop and the slide
+static bool speculative_solve_axis(Physics_worker *worker, Speculative_move *move, uint8 axis, float32 travel,
+                                   float32 extra) {
+    float32 direction = travel + extra;
+    if (direction == 0) return false;
+    uint64 body_id = move->body_id;
+    float32 *pos = state.store.pos[body_id];
+    uint8 other = !axis;
+    vec2 step = {0, 0}, step_extra = {0, 0}, moved;
+    step[axis] = travel;
+    step_extra[axis] = extra;
+    step_vec2_add(moved, pos, step);
+    step_vec2_add(moved, moved, step_extra);
+    float32 start = pos[axis], target = moved[axis];
+
+    Speculative_contact *contacts = worker->speculative->items;
+    bool stopped = false;
+    for (uint64 c = 0; c < worker->speculative->len; c++) {
+        Speculative_contact *contact = &contacts[c];
+        if (pos[other] <= contact->min[other] || pos[other] >= contact->max[other]) continue;
+        if (direction > 0 && start <= contact->min[axis] && target > contact->min[axis]) {
+            target = contact->min[axis];
+            stopped = true;
+        }
+        else if (direction < 0 && start >= contact->max[axis] && target < contact->max[axis]) {
+            target = contact->max[axis];
+            stopped = true;
+        }
+    }
+
+    // the sides along the way the other axis presses into, from the one the body starts on
+    float32 low = fminf(start, target), high = fmaxf(start, target), press = move->distance[other];
+    for (uint64 c = 0; c < worker->speculative->len && press != 0; c++) {
+        Speculative_contact *contact = &contacts[c];
+        float32 side = (press > 0) ? contact->min[other] : contact->max[other];
+        if (pos[other] != side || contact->max[axis] <= low || contact->min[axis] >= high) continue;
+        bool passed = (direction > 0) ? contact->min[axis] > start : contact->max[axis] < start;
+        float32 entry = (direction > 0) ? contact->min[axis] : contact->max[axis];
+        Collision collision = {.collided = true, .time = passed ? (entry - start) / direction : 0};
+        collision.normal[other] = (press > 0) ? -1 : 1;
+        collision.pos[axis] = passed ? entry : start;
+        collision.pos[other] = pos[other];
+        speculative_static_hit(worker, move, contact->static_id, &collision);
+    }
+
+    pos[axis] = target;
+    if (target != start) {
+        vec2_dup(move->path[move->path_len + 1], pos);
+        move->path_axis[move->path_len++] = axis;
+    }
+    if (!stopped) return false;
+
+    // every static body whose side the body stops against
+    for (uint64 c = 0; c < worker->speculative->len; c++) {
+        Speculative_contact *contact = &contacts[c];
+        float32 side = (direction > 0) ? contact->min[axis] : contact->max[axis];
+        if (side != target || pos[other] <= contact->min[other] || pos[other] >= contact->max[other]) continue;
+        Collision collision = {.collided = true, .time = (target - start) / direction};
+        collision.normal[axis] = (direction > 0) ? -1 : 1;
+        vec2_dup(collision.pos, pos);
+        speculative_static_hit(worker, move, contact->static_id, &collision);
+    }
+    return true;
+}
+
+// the sweep sets the body on the contact point of the substep it stops in and then moves the free axis
+// by the whole distance of the substep, so the free axis goes the part of that substep before the stop
+// further than free_travel, the stopped axis went from start to target of its travel
+static float32 speculative_slide(float32 free_travel, float32 travel, float32 start, float32 target, uint32 substeps) {
+#ifdef PHYSICS_FIXED_POINT
+    // in integers so it is exact, the stop and the travel have the same sign and so has the remainder
+    int64 stop = (int64) fixed_from_float(target) - fixed_from_float(start), whole = fixed_from_float(travel);
+    if (whole == 0) return 0;
+    int64 part = (stop * substeps) % whole;
+    return fixed_to_float((Fixed) ((int64) fixed_from_float(free_travel) * part / (whole * substeps)));
+#else
+    if (travel == 0) return 0;
+    float32 time = (target - start) / travel * substeps;
+    return free_travel * (time - floorf(time)) / substeps;
+#endif
+}
+
+// the end along the other axis of the sides at side the body presses into with axis, from where the other axis
+// is at from on, sides which touch count as one, false when the body is not on any of them or still is at to
+static bool speculative_side_end(Physics_worker *worker, Speculative_move *move, uint8 axis, float32 side, float32 from,
+                                 float32 to, float32 *end) {
+    uint8 other = !axis;
+    float32 press = move->distance[axis], direction = move->distance[other];
+    if (press == 0 || direction == 0) return false;
+    Speculative_contact *contacts = worker->speculative->items;
+    // a side the other axis starts on the low end of holds the body when it moves up, one it starts on
+    // the high end of does not, like the ray of the sweep
+    float32 reach = from;
+    bool pressed = false, extended = true;
+    while (extended) {
+        extended = false;
+        for (uint64 c = 0; c < worker->speculative->len; c++) {
+            Speculative_contact *contact = &contacts[c];
+            if (((press > 0) ? contact->min[axis] : contact->max[axis]) != side) continue;
+            bool holds = (direction > 0) ? contact->min[other] <= reach && reach < contact->max[other]
+                                         : contact->min[other] < reach && reach <= contact->max[other];
+            if (!holds) continue;
+            reach = (direction > 0) ? contact->max[other] : contact->min[other];
+            pressed = extended = true;
+        }
+    }
+    if (!pressed || ((direction > 0) ? to <= reach : to >= reach)) return false;
+    *end = reach;
+    return true;
+}
+
+// the sweep keeps an axis on the side it stopped at from start through the substep it stopped in and every
+// substep which begins with the other axis not yet at other_clear, the axis only moves its travel of the
+// substeps after those
+static float32 speculative_resume(float32 travel, float32 start, float32 side, float32 other_travel, float32 other_from,
+                                  float32 other_clear, uint32 substeps) {
+#ifdef PHYSICS_FIXED_POINT
+    int64 whole = fixed_from_float(travel), other_whole = fixed_from_float(other_travel);
+    if (whole == 0 || other_whole == 0) return 0;
+    int64 stop = (int64) fixed_from_float(side) - fixed_from_float(start);
+    int64 clear = (int64) fixed_from_float(other_clear) - fixed_from_float(other_from);
+    // each pair has the same sign
+    int64 stopped = llabs(stop) * substeps / llabs(whole) + 1;
+    int64 cleared = (llabs(clear) * substeps + llabs(other_whole) - 1) / llabs(other_whole);
+    int64 blocked = (stopped > cleared) ? stopped : cleared;
+    return (blocked >= substeps) ? 0 : fixed_to_float((Fixed) (whole * ((int64) substeps - blocked) / substeps));
+#else
+    if (travel == 0 || other_travel == 0) return 0;
+    float32 stopped = floorf((side - start) / travel * substeps) + 1;
+    float32 cleared = ceilf((other_clear - other_from) / other_travel * substeps);
+    float32 blocked = fmaxf(stopped, cleared);
+    return (blocked >= substeps) ? 0 : travel * (substeps - blocked) / substeps;
+#endif
+}
+
+// static hits of a body are only sent once per step for each static body and normal
+static void speculative_static_hit(Physics_worker *worker, Speculative_move *move, uint32 static_id, Collision *collision) {
+    Collision_event *events = worker->events->items;
+    for (uint64 e = move->event_begin; e < worker->events->len; e++) {
+        if (events[e].other_id == static_id && events[e].normal[0] == collision->normal[0] &&
+            events[e].normal[1] == collision->normal[1])
+            return;
+    }
+    collision->other_id = static_id;
+    event_push(worker, move->body_id, static_id, COLLISION_EVENT_STATIC_HIT, collision);
+}
+
+// the body touches the bodies along every part of its resolved move, seen where they started the tick
+static void speculative_touch_bodies(Physics_worker *worker, Speculative_move *move) {
+    Body_store *store = &state.store;
+    uint64 body_id = move->body_id;
+    uint32 *candidates = worker->candidates->items;
+    for (uint64 c = 0; c < worker->candidates->len; c++) {
+        uint32 i = candidates[c];
+        if (!(store->collision_mask[body_id] & store->collision_layer[i])) continue;
+
+        AABB grown = body_start_aabb(i);
+        step_vec2_add(grown.half_size, grown.half_size, store->half_size[body_id]);
+        vec2 min, max;
+        aabb_min_max(min, max, &grown);
+        Collision collision = {.collided = true, .other_id = i};
+        bool touched = move->path_len == 0 && speculative_segment_touch(move->path[0], 0, move->path[0][0], min, max, &collision);
+        for (uint32 p = 0; p < move->path_len && !touched; p++) {
+            uint8 axis = move->path_axis[p];
+            touched = speculative_segment_touch(move->path[p], axis, move->path[p + 1][axis], min, max, &collision);
+        }
+        if (touched) contact_touch(worker, body_id, i, &collision);
+    }
+}
+
+// a point moving from from along one axis to to against a box, touching the sides counts,
+// a point starting in the box touches it at time 0 without a normal
+static bool speculative_segment_touch(vec2 from, uint8 axis, float32 to, vec2 min, vec2 max, Collision *collision) {
+    uint8 other = !axis;
+    if (from[other] < min[other] || from[other] > max[other]) return false;
+    float32 low = fminf(from[axis], to), high = fmaxf(from[axis], to);
+    if (high < min[axis] || low > max[axis]) return false;
+
+    if (from[axis] < min[axis] || from[axis] > max[axis]) {
+        float32 side = (to > from[axis]) ? min[axis] : max[axis];
+        collision->time = (side - from[axis]) / (to - from[axis]);
+        collision->normal[axis] = (to > from[axis]) ? -1 : 1;
+    }
+    return true;
+}
+
+// moves the events of the step into the queue in body order, the same order for any number of threads
+static void events_collect(void) {
+    for (uint64 r = 0; r < state.event_ranges.len; r++) {
+        Physics_event_range *range = array_Physics_event_range_at(&state.event_ranges, r);
+        Physics_worker *worker = array_Physics_worker_at(&state.workers, range->worker);
+        Collision_event *events = worker->events->items;
+
+        for (uint64 e = range->begin; e < range->end; e++)
+            event_queue_push(&events[e]);
+    }
+}
+
+// the queue doubles instead of dropping events when it is full
+static void event_queue_push(Collision_event *event) {
+    Event_queue *queue = &state.event_queue;
+    if (queue->len == queue->capacity) {
+        Collision_event *events = memory_alloc(MEMORY_TAG, queue->capacity * 2 * sizeof(Collision_event));
+        if (!events) {
+            ERROR_RETURN((void) 0, "Unable to grow physics event queue\n");
+        }
+        for (uint64 i = 0; i < queue->len; i++)
+            events[i] = *event_queue_at(i);
+        memory_free(queue->events);
+        *queue = (Event_queue){.events = events, .head = 0, .len = queue->len, .capacity = queue->capacity * 2};
+    }
+    queue->events[(queue->head + queue->len) & (queue->capacity - 1)] = *event;
+    queue->len++;
+}
+
+static Collision_event *event_queue_at(uint64 index) {
+    Event_queue *queue = &state.event_queue;
+    return &queue->events[(queue->head + index) & (queue->capacity - 1)];
+}
+
+static void event_push(Physics_worker *worker, uint64 body_id, uint64 other_id, Collision_event_kind kind, Collision *collision) {
+    uint32 other_layer = (kind == COLLISION_EVENT_STATIC_HIT) ?
+        array_Static_body_at(&state.static_body_list, other_id)->collision_layer : state.store.collision_layer[other_id];
+    Collision_event event = {
+        .self_id = (uint32) body_id, .other_id = (uint32) other_id,
+        .normal = {collision->normal[0], collision->normal[1]}, .time = collision->time,
+        .kind = kind, .self_layer = state.store.collision_layer[body_id], .other_layer = other_layer
+    };
+    list_append(worker->events, &event);
+}
+
+// every hit and overlap of the substeps is recorded, contacts_unique keeps the first of each pair
+static void contact_touch(Physics_worker *worker, uint64 body_id, uint64 other_id, Collision *collision) {
+    if (!pixel_masks_touch(body_id, other_id)) return;
+    Collision_event contact = {
+        .self_id = (uint32) body_id, .other_id = (uint32) other_id,
+        .normal = {collision->normal[0], collision->normal[1]}, .time = collision->time,
+        .self_layer = state.store.collision_layer[body_id], .other_layer = state.store.collision_layer[other_id]
+    };
+    list_append(worker->contacts, &contact);
+}
+
+// narrow phase after the boxes touched, the body is tested where it is now and the other body where it
+// started the step like the box tests, a sweep hit of a masked pair before the move is left to the overlap
+// test after it
+static bool pixel_masks_touch(uint64 body_id, uint64 other_id) {
+    Body *body = physics_body_at(body_id), *other = physics_body_at(other_id);
+    if (!body->pixel_mask && !other->pixel_mask) return true;
+
+    int32 corner[2] = {0}, other_corner[2] = {0};
+    pixel_mask_corner(corner, body, state.store.pos[body_id]);
+    pixel_mask_corner(other_corner, other, state.store.start_pos[other_id]);
+    if (body->pixel_mask && other->pixel_mask) {
+        return pixel_mask_overlap(body->pixel_mask, body->mask_flipped, corner[0], corner[1],
+                                  other->pixel_mask, other->mask_flipped, other_corner[0], other_corner[1]);
+    }
+
+    // a mask against a plain box, the box covers the pixels it overlaps
+    Body *masked = body->pixel_mask ? body : other;
+    int32 *masked_corner = body->pixel_mask ? corner : other_corner;
+    uint64 box_id = body->pixel_mask ? other_id : body_id;
+    float32 *center = (box_id == body_id) ? state.store.pos[box_id] : state.store.start_pos[box_id];
+    float32 *half_size = state.store.half_size[box_id];
+    return pixel_mask_overlap_box(masked->pixel_mask, masked->mask_flipped, masked_corner[0], masked_corner[1],
+                                  (int32) floorf(center[0] - half_size[0]), (int32) floorf(center[1] - half_size[1]),
+                                  (int32) ceilf(center[0] + half_size[0]), (int32) ceilf(center[1] + half_size[1]));
+}
+
+// bottom left pixel of the mask of a body, only called for the bodies the masks are compared for
+static void pixel_mask_corner(int32 corner[2], Body *body, float32 *center) {
+    if (!body->pixel_mask) return;
+    corner[0] = (int32) floorf(center[0] + body->mask_offset[0] - body->pixel_mask->width * 0.5f + 0.5f);
+    corner[1] = (int32) floorf(center[1] + body->mask_offset[1] - body->pixel_mask->height * 0.5f + 0.5f);
+}
+
+// sorts the contacts of one body from begin on by other_id and drops repeated pairs
+static void contacts_unique(List *contacts, uint64 begin) {
+    Collision_event *items = contacts->items;
+    uint64 len = contacts->len;
+    // a body touches a handful of others, insertion sort keeps the first touch of a pair in front
+    for (uint64 i = begin + 1; i < len; i++) {
+        Collision_event contact = items[i];
+        uint64 j = i;
+        for (; j > begin && items[j - 1].other_id > contact.other_id; j--)
+            items[j] = items[j - 1];
+        items[j] = contact;
+    }
+    uint64 kept = begin;
+    for (uint64 i = begin; i < len; i++) {
+        if (kept > begin && items[kept - 1].other_id == items[i].other_id) continue;
+        items[kept++] = items[i];
+    }
+    contacts->len = kept;
+}
+
+// merges the contacts found in this step with the ones of the last step, both sorted by pair,
+// and queues enter, stay and exit events in body order after the static hits of the step
+static void contacts_update(void) {
+    List *found = state.contacts_found;
+    list_clear(found);
+    bool sorted = true;
+    for (uint64 r = 0; r < state.event_ranges.len; r++) {
+        Physics_event_range *range = array_Physics_event_range_at(&state.event_ranges, r);
+        Physics_worker *worker = array_Physics_worker_at(&state.workers, range->worker);
+        Collision_event *contacts = worker->contacts->items;
+        uint64 first = list_append_n(found, &contacts[range->contact_begin], range->contact_end - range->contact_begin);
+        if (first == -1) continue;
+        Collision_event *items = found->items;
+        for (uint64 c = (first > 0) ? first : 1; c < found->len; c++)
+            if (contact_less(contact_pair(&items[c]), contact_pair(&items[c - 1]))) sorted = false;
+    }
+    // every pair is found once so the order does not depend on the sort
+    if (!sorted) qsort(found->items, found->len, sizeof(Collision_event), contact_compare);
+
+    Contact_pair *old = state.contacts->items;
+    uint64 old_len = state.contacts->len, o = 0;
+    state.contacts_next->len = 0;
+    Collision_event *found_contacts = found->items;
+    for (uint64 c = 0; c < found->len; c++) {
+        Collision_event *contact = &found_contacts[c];
+        Contact_pair pair = contact_pair(contact);
+        for (; o < old_len && contact_less(old[o], pair); o++)
+            contact_lost(&old[o]);
+
+        bool known = o < old_len && !contact_less(pair, old[o]);
+        if (known) o++;
+        contact->kind = known ? COLLISION_EVENT_STAY : COLLISION_EVENT_ENTER;
+        if (!known || (state.store.flags[contact->self_id] & BODY_FLAG_CONTACT_STAY))
+            event_queue_push(contact);
+        list_append(state.contacts_next, &pair);
+    }
+    for (; o < old_len; o++)
+        contact_lost(&old[o]);
+
+    List *contacts = state.contacts;
+    state.contacts = state.contacts_next;
+    state.contacts_next = contacts;
+    state.stats.contacts = state.contacts->len;
+}
+
+// contact of the last step which the step did not find again
+// sleeping bodies were not stepped, their contacts are kept while the boxes still overlap
+// and like exits their stay events have no normal or time
+static void contact_lost(Contact_pair *pair) {
+    Body_store *store = &state.store;
+    Collision_event event = {
+        .self_id = pair->self_id, .other_id = pair->other_id, .kind = COLLISION_EVENT_EXIT,
+        .self_layer = store->collision_layer[pair->self_id], .other_layer = store->collision_layer[pair->other_id]
+    };
+    if (store->flags[pair->self_id] & BODY_FLAG_SLEEPING) {
+        AABB body = body_aabb(pair->self_id), other = body_aabb(pair->other_id);
+        if (physics_aabb_intersect(&body, &other)) {
+            event.kind = COLLISION_EVENT_STAY;
+            if (store->flags[pair->self_id] & BODY_FLAG_CONTACT_STAY)
+                event_queue_push(&event);
+            list_append(state.contacts_next, pair);
+            return;
+        }
+    }
+    event_queue_push(&event);
+}
+
+static Contact_pair contact_pair(Collision_event *contact) {
+    return (Contact_pair){contact->self_id, contact->other_id};
+}
+
+static bool contact_less(Contact_pair a, Contact_pair b) {
+    if (a.self_id != b.self_id) return a.self_id < b.self_id;
+    return a.other_id < b.other_id;
+}
+
+// qsort order of Collision_event by pair
+static int contact_compare(const void *a, const void *b) {
+    Contact_pair pair_a = contact_pair((Collision_event *) a), pair_b = contact_pair((Collision_event *) b);
+    if (contact_less(pair_a, pair_b)) return -1;
+    return contact_less(pair_b, pair_a);
+}
+
+static AABB body_aabb(uint64 body_id) {
+    return (AABB){
+        .pos = {state.store.pos[body_id][0], state.store.pos[body_id][1]},
+        .half_size = {state.store.half_size[body_id][0], state.store.half_size[body_id][1]}
+    };
+}
+
+static AABB body_start_aabb(uint64 body_id) {
+    return (AABB){
+        .pos = {state.store.start_pos[body_id][0], state.store.start_pos[body_id][1]},
+        .half_size = {state.store.half_size[body_id][0], state.store.half_size[body_id][1]}
+    };
+}
+
+// bounds covering everywhere the body can be during this tick
+static void swept_bounds(vec2 min, vec2 max, uint64 body_id) {
+    vec2 distance;
+    vec2_scale(distance, state.store.velocity[body_id], state.step_delta);
+    vec2_sub(min, state.store.pos[body_id], state.store.half_size[body_id]);
+    vec2_add(max, state.store.pos[body_id], state.store.half_size[body_id]);
+    for (uint8 i = 0; i < 2; i++) {
+        if (distance[i] < 0) min[i] += distance[i];
+        else max[i] += distance[i];
+        min[i] -= BROADPHASE_MARGIN;
+        max[i] += BROADPHASE_MARGIN;
+    }
+}
+
+static void broadphase_update(uint64 body_count) {
+    Body_store *store = &state.store;
+    // the groups every layer is tested by come from the masks of this step's bodies,
+    // groups without bodies are skipped until they are filled again
+    state.filled_groups = 0;
+    memset(state.tested_by, 0, sizeof(state.tested_by));
+    for (uint32 motion = 0; motion < BODY_MOTION_COUNT; motion++) {
+        List *partition = store->partitions[motion];
+        uint32 *ids = partition->items;
+        for (uint64 p = 0; p < partition->len; p++) {
+            uint64 groups = body_groups(ids[p]);
+            state.filled_groups |= groups;
+            uint32 mask = store->collision_mask[ids[p]];
+            for (uint32 l = 0; l < PHYSICS_LAYER_COUNT && mask >> l; l++) {
+                if (mask & (1u << l)) state.tested_by[l] |= groups;
+            }
+        }
+    }
+
+    if (state.broadphase == PHYSICS_BROADPHASE_SAP) {
+        sap_clear(&state.sap, body_count);
+    }
+    else if (state.broadphase == PHYSICS_BROADPHASE_BRUTE_FORCE) {
+        // inactive bodies keep empty bounds so the brute force list stays indexed by body id
+        if (!array_vec4_reserve(&state.body_bounds, body_count)) {
+            ERROR_EXIT_PROGRAM("Unable to allocate memory for brute force bounds\n");
+        }
+        state.body_bounds.len = body_count;
+        for (uint64 i = 0; i < body_count; i++)
+            vec4_dup(state.body_bounds.items[i], (vec4){1, 1, -1, -1});
+        for (uint32 g = 0; g < LAYER_GROUP_COUNT; g++)
+            state.layer_ids[g]->len = 0;
+    }
+    else {
+        for (uint32 g = 0; g < LAYER_GROUP_COUNT; g++) {
+            if (state.filled_groups & (1ull << g)) grid_clear(&state.layer_grids[g], body_count);
+        }
+    }
+
+    for (uint32 motion = 0; motion < BODY_MOTION_COUNT; motion++) {
+        List *partition = store->partitions[motion];
+        uint32 *ids = partition->items;
+        state.stats.active_bodies += partition->len;
+        for (uint64 p = 0; p < partition->len; p++) {
+            uint32 i = ids[p];
+            vec2 min, max;
+            swept_bounds(min, max, i);
+
+            if (state.broadphase == PHYSICS_BROADPHASE_SAP) {
+                sap_insert(&state.sap, i, min, max, store->collision_layer[i], store->collision_mask[i]);
+                continue;
+            }
+            if (state.broadphase == PHYSICS_BROADPHASE_BRUTE_FORCE) {
+                vec4_dup(*array_vec4_at(&state.body_bounds, i), (vec4){min[0], min[1], max[0], max[1]});
+            }
+            uint64 groups = body_groups(i);
+            for (uint32 g = 0; groups >> g; g++) {
+                if (!(groups & (1ull << g))) continue;
+                if (state.broadphase == PHYSICS_BROADPHASE_BRUTE_FORCE) list_append(state.layer_ids[g], &i);
+                else grid_insert(&state.layer_grids[g], i, min, max);
+            }
+        }
+    }
+
+    if (state.broadphase == PHYSICS_BROADPHASE_SAP) {
+        sap_build(&state.sap);
+        return;
+    }
+    for (uint32 g = 0; g < LAYER_GROUP_COUNT; g++) {
+        if (!(state.filled_groups & (1ull << g))) continue;
+        // the partitions are sorted one by one, queries expect the whole group in id order
+        if (state.broadphase == PHYSICS_BROADPHASE_BRUTE_FORCE)
+            broadphase_indices_unique(state.layer_ids[g]->items, state.layer_ids[g]->len);
+        else
+            grid_build(&state.layer_grids[g]);
+    }
 }
 
-static void stationary_response(Body *body) {
-    for (uint32 i = 0; i < state.static_body_list->len; i++) {
-        Static_body *static_body = physics_static_body_get(i);
-        if (!(body->collision_mask & static_body->collision_layer)) continue;
-        AABB aabb = minkowsky_diff_aabb(&static_body->aabb, &body->aabb);
+// every layer of the body is a group, bodies without a layer share one
+static uint64 body_groups(uint64 body_id) {
+    uint32 layer = state.store.collision_layer[body_id];
+    return layer ? layer : 1ull << LAYER_GROUP_NONE;
+}
+
+// the groups in the mask of the body and the groups of the bodies which have its layer in their mask,
+// the candidates of the second kind are only there to wake sleeping bodies
+static uint64 body_query_groups(uint64 body_id) {
+    uint64 groups = state.store.collision_mask[body_id];
+    uint32 layer = state.store.collision_layer[body_id];
+    for (uint32 l = 0; l < PHYSICS_LAYER_COUNT && layer >> l; l++) {
+        if (layer & (1u << l)) groups |= state.tested_by[l];
+    }
+    return groups & state.filled_groups;
+}
+
+// fills the candidate lists of the worker with every body and static body the given body can touch during this tick
+// the broadphase holds the swept bounds of the other bodies from the start of the tick
+// refit is false for the first query of the body in a step, its bounds then match the ones in the broadphase
+static void broadphase_query(Physics_worker *worker, uint64 body_id, bool refit) {
+    vec2 min, max;
+    swept_bounds(min, max, body_id);
+    vec2_dup(worker->query_min, min);
+    vec2_dup(worker->query_max, max);
+
+    worker->static_candidates->len = 0;
+    aabb_tree_query(&state.static_tree, min, max, worker->tree_stack, worker->static_candidates);
+    broadphase_query_bodies(worker, body_id, min, max, refit);
+}
+
+// fills only the body candidates, for triggers which never touch static bodies
+static void broadphase_query_bodies(Physics_worker *worker, uint64 body_id, vec2 min, vec2 max, bool refit) {
+    worker->candidates->len = 0;
+    uint64 found;
+    if (state.broadphase == PHYSICS_BROADPHASE_SAP) {
+        // the sweep already found the pairs of the inserted bounds, without the body itself
+        if (!refit) {
+            sap_query_item(&state.sap, (uint32) body_id, worker->candidates);
+            return;
+        }
+        found = sap_query(&state.sap, min, max, state.store.collision_layer[body_id],
+                          state.store.collision_mask[body_id], worker->candidates);
+    }
+    else {
+        uint64 groups = body_query_groups(body_id);
+        uint32 filled = 0;
+        for (uint32 g = 0; groups >> g; g++) {
+            if (!(groups & (1ull << g))) continue;
+            uint64 len = worker->candidates->len;
+            if (state.broadphase == PHYSICS_BROADPHASE_BRUTE_FORCE)
+                brute_force_query(g, min, max, worker->candidates);
+            else
+                grid_query(&state.layer_grids[g], min, max, worker->candidates);
+            if (worker->candidates->len > len) filled++;
+        }
+        // bodies on several layers are found once in every group
+        if (filled > 1)
+            worker->candidates->len = broadphase_indices_unique(worker->candidates->items, worker->candidates->len);
+        found = worker->candidates->len;
+    }
+
+    // remove the body itself, the list is sorted so it can only be found once
+    uint32 *candidates = worker->candidates->items;
+    for (uint64 i = 0; i < found; i++) {
+        if (candidates[i] != body_id) continue;
+        memmove(&candidates[i], &candidates[i + 1], (found - i - 1) * sizeof(uint32));
+        found--;
+        worker->candidates->len--;
+        break;
+    }
+}
+
+// a body pushed out of a static body can leave its swept bounds, find its new neighbours
+// returns true if the candidate lists were rebuilt
+static bool broadphase_refit(Physics_worker *worker, uint64 body_id) {
+    vec2 min, max;
+    swept_bounds(min, max, body_id);
+    if (min[0] >= worker->query_min[0] && min[1] >= worker->query_min[1] &&
+        max[0] <= worker->query_max[0] && max[1] <= worker->query_max[1])
+        return false;
+
+    broadphase_query(worker, body_id, true);
+    return true;
+}
+
+// appends every body of the group whose swept bounds overlap min/max in ascending order
+static void brute_force_query(uint32 group, vec2 min, vec2 max, List *result) {
+    vec4 *bounds = state.body_bounds.items;
+    uint32 *ids = state.layer_ids[group]->items;
+    for (uint64 i = 0; i < state.layer_ids[group]->len; i++) {
+        float32 *b = bounds[ids[i]];
+        if (b[0] > max[0] || b[2] < min[0] || b[1] > max[1] || b[3] < min[1]) continue;
+        list_append(result, &ids[i]);
+    }
+}
+
+static void stationary_response(Physics_worker *worker, uint64 body_id) {
+    Body_store *store = &state.store;
+    // sweeps starting inside of a static body can move the body backwards
+    broadphase_refit(worker, body_id);
+
+    uint32 *static_candidates = worker->static_candidates->items;
+    for (uint64 c = 0; c < worker->static_candidates->len; c++) {
+        uint32 i = static_candidates[c];
+        Static_body *static_body = array_Static_body_at(&state.static_body_list, i);
+        if (!(store->collision_mask[body_id] & static_body->collision_layer)) continue;
+        AABB body = body_aabb(body_id);
+        AABB aabb = minkowsky_diff_aabb(&static_body->aabb, &body);
 
         vec2 min, max;
         aabb_min_max(min, max, &aabb);
@@ -240,132 +2103,148 @@ static void stationary_response(Body *body) {
             // move object according to penetration vector
             vec2 penetration_vector;
             minkowsky_diff_pen_vector(penetration_vector, &aabb);
-            vec2_add(body->aabb.pos, body->aabb.pos, penetration_vector);
+            step_vec2_add(store->pos[body_id], store->pos[body_id], penetration_vector);
+
+            // continue with the static bodies after this one in the new candidate list
+            if (broadphase_refit(worker, body_id)) {
+                static_candidates = worker->static_candidates->items;
+                for (c = 0; c < worker->static_candidates->len && static_candidates[c] <= i; c++);
+                c--;
+            }
         }
     }
 
     // update against bodies
-    if (!body->on_hit) return;
-    for (uint64 i = 0; i < state.body_list->len; i++) {
-        Body *other = physics_body_get(i);
-        if (!(body->collision_mask & other->collision_layer) || !other->active) continue;
-        AABB aabb = minkowsky_diff_aabb(&other->aabb, &body->aabb);
+    uint32 *candidates = worker->candidates->items;
+    for (uint64 c = 0; c < worker->candidates->len; c++) {
+        uint64 i = candidates[c];
+        if (!(store->collision_mask[body_id] & store->collision_layer[i])) continue;
+        AABB body = body_aabb(body_id), other = body_start_aabb(i);
+        AABB aabb = minkowsky_diff_aabb(&other, &body);
 
         vec2 min, max;
         aabb_min_max(min, max, &aabb);
-        if (min[0] <= 0 && max[0] >= 0 && min[1] <= 0 && max[1] >= 0) {
-            body->on_hit(body, other, &(Collision){.collided = true, .other_id = i});
-        }
+        if (min[0] <= 0 && max[0] >= 0 && min[1] <= 0 && max[1] >= 0)
+            contact_touch(worker, body_id, i, &(Collision){.collided = true, .other_id = i});
     }
 }
-static void sweep_response(Body *body, vec2 distance) {
-    Collision collision = sweep_static_bodies(body, distance);
-    Collision collision_moving = sweep_bodies(body, distance);
+static void sweep_response(Physics_worker *worker, uint64 body_id, vec2 distance) {
+    Collision collision = sweep_static_bodies(worker, body_id, distance);
+    Collision collision_moving = sweep_bodies(worker, body_id, distance);
 
-    if (collision_moving.collided && body->on_hit)
-        body->on_hit(body, physics_body_get(collision_moving.other_id), &collision_moving);
+    if (collision_moving.collided)
+        contact_touch(worker, body_id, collision_moving.other_id, &collision_moving);
 
+    float32 *pos = state.store.pos[body_id];
     if (collision.collided) {
-        body->aabb.pos[0] = collision.pos[0];
-        body->aabb.pos[1] = collision.pos[1];
+        pos[0] = collision.pos[0];
+        pos[1] = collision.pos[1];
 
         // reset velocity in the direction of collision and move in the other direction
         if (collision.normal[0] != 0) {
-            body->aabb.pos[1] += distance[1];
+            step_vec2_add(pos, pos, (vec2){0, distance[1]});
         }
         if (collision.normal[1] != 0) {
-            body->aabb.pos[0] += distance[0];
-        }
-        if (body->on_static_hit) {
-            body->on_static_hit(body, physics_static_body_get(collision.other_id), &collision);
+            step_vec2_add(pos, pos, (vec2){distance[0], 0});
         }
+        event_push(worker, body_id, collision.other_id, COLLISION_EVENT_STATIC_HIT, &collision);
     }
     // no collisions
     else {
-        vec2_add(body->aabb.pos, body->aabb.pos, distance);
+        step_vec2_add(pos, pos, distance);
     }
 }
 
-static Collision sweep_static_bodies(Body *body, vec2 velocity) {
+static Collision sweep_static_bodies(Physics_worker *worker, uint64 body_id, vec2 velocity) {
+    Body_store *store = &state.store;
     Collision result = {.time = 0xBEEF};
+    Ray_batch batch = {0};
+    uint32 ids[RAY_BATCH_WIDTH];
 
-    for (uint32 i = 0; i < state.static_body_list->len; i++) {
-        Static_body *static_body = physics_static_body_get(i);
-        update_sweep_result_static(&result, body, i, velocity);
+    uint32 *static_candidates = worker->static_candidates->items;
+    for (uint64 c = 0; c < worker->static_candidates->len; c++) {
+        uint32 i = static_candidates[c];
+        Static_body *static_body = array_Static_body_at(&state.static_body_list, i);
+        if (!(store->collision_mask[body_id] & static_body->collision_layer)) continue;
+
+        AABB sum_aabb = static_body->aabb;
+        // calculate collision aabb
+        step_vec2_add(sum_aabb.half_size, sum_aabb.half_size, store->half_size[body_id]);
+        ids[batch.count] = i;
+        ray_batch_add(&batch, &sum_aabb);
+        if (batch.count == RAY_BATCH_WIDTH)
+            sweep_batch(&result, body_id, velocity, &batch, ids, true);
     }
+    sweep_batch(&result, body_id, velocity, &batch, ids, true);
     return result;
 }
 
-static Collision sweep_bodies(Body *body, vec2 velocity) {
+static Collision sweep_bodies(Physics_worker *worker, uint64 body_id, vec2 velocity) {
+    Body_store *store = &state.store;
     Collision result = {.time = 0xBEEF};
+    Ray_batch batch = {0};
+    uint32 ids[RAY_BATCH_WIDTH];
+
+    uint32 *candidates = worker->candidates->items;
+    for (uint64 c = 0; c < worker->candidates->len; c++) {
+        uint32 i = candidates[c];
+        if (!(store->collision_mask[body_id] & store->collision_layer[i])) continue;
 
-    for (uint32 i = 0; i < state.body_list->len; i++) {
-        Body *other = physics_body_get(i);
-        if (body == other || !other->active) continue;
-        update_sweep_result(&result, body, i, velocity);
+        AABB sum_aabb = body_start_aabb(i);
+        // calculate collision aabb
+        step_vec2_add(sum_aabb.half_size, sum_aabb.half_size, store->half_size[body_id]);
+        ids[batch.count] = i;
+        ray_batch_add(&batch, &sum_aabb);
+        if (batch.count == RAY_BATCH_WIDTH)
+            sweep_batch(&result, body_id, velocity, &batch, ids, false);
     }
+    sweep_batch(&result, body_id, velocity, &batch, ids, false);
     return result;
 }
 
-static void update_sweep_result(Collision *result, Body *body, uint64 other_id, vec2 velocity) {
-    Body *other = physics_body_get(other_id);
-    if (!(body->collision_mask & other->collision_layer)) return;
-
-    AABB sum_aabb = other->aabb;
-    // calculate collision aabb
-    vec2_add(sum_aabb.half_size, sum_aabb.half_size, body->aabb.half_size);
-    // cast a ray from the object's position to collsion rectangle
-    Collision hit = ray_collide_aabb(body->aabb.pos, velocity, sum_aabb);
+// casts a ray from the object's position to every collision rectangle in the batch and empties it
+// hits are folded into the result in candidate order
+static void sweep_batch(Collision *result, uint64 body_id, vec2 velocity, Ray_batch *batch, uint32 *ids, bool is_static) {
+    if (batch->count == 0) return;
+    Collision hits[RAY_BATCH_WIDTH];
+    uint32 mask = ray_collide_aabb_batch(state.store.pos[body_id], velocity, batch, hits);
 
-    if (!hit.collided) return;
-
-    // if (body->on_hit)
-    //     body->on_hit(body, other, &hit);
-    if (hit.time < result->time)
-        *result = hit;
-    else if (hit.time == result->time) {
-        // solve highest velocity axis first
-        if (fabsf(velocity[0]) > fabsf(velocity[1]) && hit.normal[0] != 0)
-            *result = hit;
-        else if (fabsf(velocity[1]) > fabsf(velocity[0]) && hit.normal[1] != 0)
-            *result = hit;
+    for (uint32 lane = 0; lane < batch->count; lane++) {
+        if (!(mask & (1u << lane))) continue;
+        if (is_static)
+            update_sweep_result_static(result, &hits[lane], ids[lane], velocity);
+        else
+            update_sweep_result(result, &hits[lane], ids[lane], velocity);
     }
-    result->other_id = other_id;
+    batch->count = 0;
 }
 
-static void update_sweep_result_static(Collision *result, Body *body, uint64 other_id, vec2 velocity) {
-    Static_body *static_body = physics_static_body_get(other_id);
-    if (!(body->collision_mask & static_body->collision_layer)) return;
-
-    AABB sum_aabb = static_body->aabb;
-    // calculate collision aabb
-    vec2_add(sum_aabb.half_size, sum_aabb.half_size, body->aabb.half_size);
-    // cast a ray from the object's position to collsion rectangle
-    Collision hit = ray_collide_aabb(body->aabb.pos, velocity, sum_aabb);
+static void update_sweep_result(Collision *result, Collision *hit, uint64 other_id, vec2 velocity) {
+    bool nearer = hit->time < result->time;
+    // solve highest velocity axis first
+    if (hit->time == result->time)
+        nearer = (fabsf(velocity[0]) > fabsf(velocity[1]) && hit->normal[0] != 0) ||
+                 (fabsf(velocity[1]) > fabsf(velocity[0]) && hit->normal[1] != 0);
+    if (!nearer) return;
+    *result = *hit;
+    result->other_id = other_id;
+}
 
+static void update_sweep_result_static(Collision *result, Collision *hit, uint64 other_id, vec2 velocity) {
     vec2 temp_normal = {result->normal[0], result->normal[1]};
-    if (!hit.collided) return;
-
-    // if (body->on_static_hit)
-    //     body->on_static_hit(body, static_body, &hit);
-    if (hit.time < result->time)
-        *result = hit;
-    else if (hit.time == result->time) {
-        // solve highest velocity axis first
-        if (fabsf(velocity[0]) > fabsf(velocity[1]) && hit.normal[0] != 0)
-            *result = hit;
-        else if (fabsf(velocity[1]) > fabsf(velocity[0]) && hit.normal[1] != 0)
-            *result = hit;
-    }
-    result->other_id = other_id;
-    if (hit.normal[0] == 0) result->normal[0] = temp_normal[0];
-    if (hit.normal[1] == 0) result->normal[1] = temp_normal[1];
+
+    float32 time = result->time;
+    update_sweep_result(result, hit, other_id, velocity);
+    // only static bodies the body runs into at the same time, like a floor and a wall, merge their normals
+    if (hit->time != time) return;
+    if (hit->normal[0] == 0) result->normal[0] = temp_normal[0];
+    if (hit->normal[1] == 0) result->normal[1] = temp_normal[1];
 }
 
 uint64 physics_body_count(void) {
-    return state.body_list->len;
+    return state.store.len;
 }
 
 uint64 physics_static_body_count(void) {
-    return state.static_body_list->len;
+    return state.static_body_list.len;
 }
@@ -0,0 +1,223 @@
+#include "physics_fixed.h"
+
+static Fixed fixed_saturate(int64 value);
+static int64 fixed_abs(Fixed value);
+static void fixed_velocity_update(Body_store *store, uint32 *ids, uint64 count, Fixed gravity_step, Fixed terminal, Fixed step);
+
+// truncates towards zero, out of range values saturate and NaN becomes the lowest value
+// the same as clamping and _mm_cvttps_epi32 in the SIMD kernels
+Fixed fixed_from_float(float32 value) {
+    float32 scaled = value * FIXED_ONE;
+    if (!(scaled > FIXED_SCALED_MIN)) return INT32_MIN;
+    if (scaled > FIXED_SCALED_MAX) return (Fixed) FIXED_SCALED_MAX;
+    return (Fixed) scaled;
+}
+
+float32 fixed_to_float(Fixed value) {
+    return (float32) value * (1.0f / FIXED_ONE);
+}
+
+// adds and products wrap around like the SIMD lanes instead of being undefined
+Fixed fixed_add(Fixed a, Fixed b) {
+    return (Fixed) ((uint32) a + (uint32) b);
+}
+
+Fixed fixed_mul(Fixed a, Fixed b) {
+    return (Fixed) (uint32) (((int64) a * b) >> FIXED_SHIFT);
+}
+
+void fixed_vec2_add(vec2 result, vec2 a, vec2 b) {
+    for (uint8 i = 0; i < 2; i++)
+        result[i] = fixed_to_float(fixed_add(fixed_from_float(a[i]), fixed_from_float(b[i])));
+}
+
+// v * scale / divisor, the divisor applies to the fixed scale so nothing is divided in float
+void fixed_vec2_scale(vec2 result, vec2 v, float32 scale, uint32 divisor) {
+    Fixed factor = fixed_from_float(scale) / (Fixed) divisor;
+    for (uint8 i = 0; i < 2; i++)
+        result[i] = fixed_to_float(fixed_mul(fixed_from_float(v[i]), factor));
+}
+
+void fixed_aabb_min_max(vec2 min, vec2 max, AABB *aabb) {
+    for (uint8 i = 0; i < 2; i++) {
+        int64 pos = fixed_from_float(aabb->pos[i]), half_size = fixed_from_float(aabb->half_size[i]);
+        min[i] = fixed_to_float(fixed_saturate(pos - half_size));
+        max[i] = fixed_to_float(fixed_saturate(pos + half_size));
+    }
+}
+
+AABB fixed_minkowsky_diff_aabb(AABB *a, AABB *b) {
+    AABB diff;
+    for (uint8 i = 0; i < 2; i++) {
+        int64 pos = (int64) fixed_from_float(a->pos[i]) - fixed_from_float(b->pos[i]);
+        int64 half_size = (int64) fixed_from_float(a->half_size[i]) + fixed_from_float(b->half_size[i]);
+        diff.pos[i] = fixed_to_float(fixed_saturate(pos));
+        diff.half_size[i] = fixed_to_float(fixed_saturate(half_size));
+    }
+    return diff;
+}
+
+bool fixed_aabb_intersect(AABB *a, AABB *b) {
+    for (uint8 i = 0; i < 2; i++) {
+        int64 distance = (int64) fixed_from_float(a->pos[i]) - fixed_from_float(b->pos[i]);
+        int64 reach = (int64) fixed_from_float(a->half_size[i]) + fixed_from_float(b->half_size[i]);
+        if (distance > reach || -distance > reach) return false;
+    }
+    return true;
+}
+
+bool fixed_point_intersect(vec2 point, AABB *aabb) {
+    for (uint8 i = 0; i < 2; i++) {
+        int64 distance = (int64) fixed_from_float(point[i]) - fixed_from_float(aabb->pos[i]);
+        int64 half_size = fixed_from_float(aabb->half_size[i]);
+        if (distance > half_size || -distance > half_size) return false;
+    }
+    return true;
+}
+
+// same choice of axis as minkowsky_diff_pen_vector
+void fixed_minkowsky_diff_pen_vector(vec2 result, AABB *minkowsky_aabb) {
+    Fixed min[2], max[2];
+    for (uint8 i = 0; i < 2; i++) {
+        int64 pos = fixed_from_float(minkowsky_aabb->pos[i]), half_size = fixed_from_float(minkowsky_aabb->half_size[i]);
+        min[i] = fixed_saturate(pos - half_size);
+        max[i] = fixed_saturate(pos + half_size);
+    }
+
+    Fixed min_dist_signed = fixed_abs(min[0]) < fixed_abs(min[1]) ? min[0] : min[1];
+    int64 min_dist = fixed_abs(min_dist_signed);
+    Fixed pen[2] = {min_dist_signed, 0};
+
+    if (fixed_abs(max[0]) < min_dist) {
+        min_dist = fixed_abs(max[0]);
+        pen[0] = max[0];
+    }
+    if (fixed_abs(min[0]) < min_dist) {
+        min_dist = fixed_abs(min[0]);
+        pen[0] = 0;
+        pen[1] = min[1];
+    }
+    if (fixed_abs(max[1]) < min_dist) {
+        pen[0] = 0;
+        pen[1] = max[1];
+    }
+    result[0] = fixed_to_float(pen[0]);
+    result[1] = fixed_to_float(pen[1]);
+}
+
+// slab test of ray_collide_aabb, times are kept in 64 bits since short rays divide by small magnitudes
+Collision fixed_ray_collide_aabb(vec2 pos, vec2 magnitude, AABB aabb) {
+    Collision result = {0};
+    Fixed origin[2], length[2], center[2], half_size[2];
+    int64 last_entry = INT64_MIN, first_exit = INT64_MAX;
+
+    for (uint8 i = 0; i < 2; i++) {
+        origin[i] = fixed_from_float(pos[i]);
+        length[i] = fixed_from_float(magnitude[i]);
+        center[i] = fixed_from_float(aabb.pos[i]);
+        half_size[i] = fixed_from_float(aabb.half_size[i]);
+        int64 min = (int64) center[i] - half_size[i], max = (int64) center[i] + half_size[i];
+
+        if (length[i] != 0) {
+            int64 t1 = (min - origin[i]) * FIXED_ONE / length[i];
+            int64 t2 = (max - origin[i]) * FIXED_ONE / length[i];
+
+            int64 entry = (t1 < t2) ? t1 : t2, exit = (t1 < t2) ? t2 : t1;
+            if (entry > last_entry) last_entry = entry;
+            if (exit < first_exit) first_exit = exit;
+        }
+        else if (origin[i] <= min || origin[i] >= max) {
+            return result;
+        }
+    }
+    if (first_exit > last_entry && first_exit > 0 && last_entry < FIXED_ONE) {
+        Fixed time = fixed_saturate(last_entry);
+        Fixed hit[2];
+        for (uint8 i = 0; i < 2; i++)
+            hit[i] = fixed_saturate((int64) origin[i] + (((int64) length[i] * time) >> FIXED_SHIFT));
+        result.pos[0] = fixed_to_float(hit[0]);
+        result.pos[1] = fixed_to_float(hit[1]);
+        result.collided = true;
+        result.time = fixed_to_float(time);
+
+        int64 dx = (int64) hit[0] - center[0];
+        int64 dy = (int64) hit[1] - center[1];
+        int64 px = half_size[0] - (dx < 0 ? -dx : dx);
+        int64 py = half_size[1] - (dy < 0 ? -dy : dy);
+
+        // set normal for the direction of collision
+        if (px < py)
+            result.normal[0] = (dx > 0) - (dx < 0);
+        else
+            result.normal[1] = (dy > 0) - (dy < 0);
+    }
+    return result;
+}
+
+// body_store_integrate in fixed point
+void fixed_integrate(Body_store *store, uint32 *ids, uint64 count, float32 gravity, float32 terminal_velocity, float32 delta) {
+    Fixed step = fixed_from_float(delta);
+    fixed_velocity_update(store, ids, count, fixed_mul(fixed_from_float(gravity), step), fixed_from_float(terminal_velocity), step);
+}
+
+// body_store_accelerate in fixed point, no gravity and a terminal velocity nothing is below
+void fixed_accelerate(Body_store *store, uint32 *ids, uint64 count, float32 delta) {
+    fixed_velocity_update(store, ids, count, 0, INT32_MIN, fixed_from_float(delta));
+}
+
+static Fixed fixed_saturate(int64 value) {
+    if (value > INT32_MAX) return INT32_MAX;
+    if (value < INT32_MIN) return INT32_MIN;
+    return (Fixed) value;
+}
+
+static int64 fixed_abs(Fixed value) {
+    return (value < 0) ? -(int64) value : value;
+}
+
+// the SIMD path only uses integer lanes between the conversions
+static void fixed_velocity_update(Body_store *store, uint32 *ids, uint64 count, Fixed gravity_step, Fixed terminal, Fixed step) {
+    uint64 i = 0;
+#ifdef BODY_STORE_SSE2
+    const __m128 scale = _mm_set1_ps(FIXED_ONE), unscale = _mm_set1_ps(1.0f / FIXED_ONE);
+    const __m128 scaled_min = _mm_set1_ps(FIXED_SCALED_MIN), scaled_max = _mm_set1_ps(FIXED_SCALED_MAX);
+    const __m128i gravity_lanes = _mm_set_epi32(gravity_step, 0, gravity_step, 0);
+    const __m128i terminal_lanes = _mm_set_epi32(terminal, INT32_MIN, terminal, INT32_MIN);
+    // step sits in the high half of each 64 bit lane to correct the unsigned products of negative values
+    const __m128i step_lanes = _mm_set1_epi32(step), step_high = _mm_set_epi32(step, 0, step, 0);
+    for (; i + 2 <= count; i += 2) {
+        float32 *velocity_0 = store->velocity[ids[i]], *velocity_1 = store->velocity[ids[i + 1]];
+        __m128 scaled = _mm_mul_ps(body_store_load_pair(velocity_0, velocity_1), scale);
+        __m128i velocity = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(scaled, scaled_min), scaled_max));
+        scaled = _mm_mul_ps(body_store_load_pair(store->acceleration[ids[i]], store->acceleration[ids[i + 1]]), scale);
+        __m128i acceleration = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(scaled, scaled_min), scaled_max));
+
+        // acceleration * step as fixed_mul does it, bits 16 to 47 of the 64 bit products
+        __m128i negative = _mm_srai_epi32(acceleration, 31);
+        __m128i even = _mm_mul_epu32(acceleration, step_lanes);
+        __m128i odd = _mm_mul_epu32(_mm_srli_epi64(acceleration, 32), step_lanes);
+        even = _mm_sub_epi64(even, _mm_and_si128(_mm_shuffle_epi32(negative, _MM_SHUFFLE(2, 2, 0, 0)), step_high));
+        odd = _mm_sub_epi64(odd, _mm_and_si128(_mm_shuffle_epi32(negative, _MM_SHUFFLE(3, 3, 1, 1)), step_high));
+        even = _mm_shuffle_epi32(_mm_srli_epi64(even, FIXED_SHIFT), _MM_SHUFFLE(0, 0, 2, 0));
+        odd = _mm_shuffle_epi32(_mm_srli_epi64(odd, FIXED_SHIFT), _MM_SHUFFLE(0, 0, 2, 0));
+        acceleration = _mm_unpacklo_epi32(even, odd);
+
+        velocity = _mm_add_epi32(velocity, gravity_lanes);
+        __m128i above = _mm_cmpgt_epi32(velocity, terminal_lanes);
+        velocity = _mm_or_si128(_mm_and_si128(above, velocity), _mm_andnot_si128(above, terminal_lanes));
+        velocity = _mm_add_epi32(velocity, acceleration);
+        body_store_store_pair(velocity_0, velocity_1, _mm_mul_ps(_mm_cvtepi32_ps(velocity), unscale));
+    }
+#endif
+    for (; i < count; i++) {
+        float32 *velocity = store->velocity[ids[i]], *acceleration = store->acceleration[ids[i]];
+        Fixed x = fixed_from_float(velocity[0]), y = fixed_add(fixed_from_float(velocity[1]), gravity_step);
+        // limit y velocity to terminal velocity
+        if (terminal > y)
+            y = terminal;
+        x = fixed_add(x, fixed_mul(fixed_from_float(acceleration[0]), step));
+        y = fixed_add(y, fixed_mul(fixed_from_float(acceleration[1]), step));
+        velocity[0] = fixed_to_float(x);
+        velocity[1] = fixed_to_float(y);
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef PHYSICS_FIXED_H
+#define PHYSICS_FIXED_H
+
+#include <linmath.h>
+#include "../types.h"
+#include "physics.h"
+#include "body_store.h"
+
+// Q16.16 arithmetic for the physics core, used in place of float32 math when built with PHYSICS_FIXED_POINT
+// body data stays float32, values are converted on the way in and out so every build and machine
+// computes the same bits, the conversions themselves are exact or correctly rounded
+typedef int32 Fixed;
+
+#define FIXED_SHIFT 16
+#define FIXED_ONE (1 << FIXED_SHIFT)
+// bounds of the scaled float before the conversion, the upper one is the largest float below 2^31,
+// SIMD conversions clamp to these before _mm_cvttps_epi32 to match fixed_from_float
+#define FIXED_SCALED_MIN -2147483648.0f
+#define FIXED_SCALED_MAX 2147483520.0f
+
+Fixed fixed_from_float(float32 value);
+float32 fixed_to_float(Fixed value);
+Fixed fixed_add(Fixed a, Fixed b);
+Fixed fixed_mul(Fixed a, Fixed b);
+
+void fixed_vec2_add(vec2 result, vec2 a, vec2 b);
+void fixed_vec2_scale(vec2 result, vec2 v, float32 scale, uint32 divisor);
+void fixed_aabb_min_max(vec2 min, vec2 max, AABB *aabb);
+AABB fixed_minkowsky_diff_aabb(AABB *a, AABB *b);
+bool fixed_aabb_intersect(AABB *a, AABB *b);
+bool fixed_point_intersect(vec2 point, AABB *aabb);
+void fixed_minkowsky_diff_pen_vector(vec2 result, AABB *minkowsky_aabb);
+Collision fixed_ray_collide_aabb(vec2 pos, vec2 magnitude, AABB aabb);
+void fixed_integrate(Body_store *store, uint32 *ids, uint64 count, float32 gravity, float32 terminal_velocity, float32 delta);
+void fixed_accelerate(Body_store *store, uint32 *ids, uint64 count, float32 delta);
+
+#endif // !PHYSICS_FIXED_H
@@ -0,0 +1,83 @@
+#define MEMORY_TAG MEMORY_TAG_PHYSICS
+
+#include <stdlib.h>
+
+#include "pixel_mask.h"
+#include "../memory.h"
+#include "../utils.h"
+
+static uint64 row_bits(int32 begin, int32 end);
+
+// pixels points at the bottom left pixel of the frame and stride is the byte length of an image row,
+// images without an alpha channel are solid everywhere
+bool pixel_mask_init(Pixel_mask *mask, uint8 *pixels, uint64 stride, uint32 channel_count, uint32 width, uint32 height) {
+    *mask = (Pixel_mask){0};
+    if (width == 0 || width > PIXEL_MASK_MAX_WIDTH) {
+        ERROR_RETURN(false, "Pixel mask can't be %u pixels wide\n", width);
+    }
+    uint64 *rows = memory_alloc(MEMORY_TAG, height * 2 * sizeof(uint64));
+    if (height > 0 && !rows) {
+        ERROR_RETURN(false, "Unable to allocate memory for pixel mask\n");
+    }
+
+    bool has_alpha = channel_count == 2 || channel_count == 4;
+    for (uint32 y = 0; y < height; y++) {
+        uint8 *row = pixels + y * stride;
+        uint64 bits = 0, mirrored = 0;
+        for (uint32 x = 0; x < width; x++) {
+            if (has_alpha && row[x * channel_count + channel_count - 1] < PIXEL_MASK_ALPHA_THRESHOLD) continue;
+            bits |= 1ull << x;
+            mirrored |= 1ull << (width - 1 - x);
+        }
+        rows[y] = bits;
+        rows[height + y] = mirrored;
+    }
+    *mask = (Pixel_mask){.width = width, .height = height, .rows = rows, .mirrored = rows + height};
+    return true;
+}
+
+void pixel_mask_free(Pixel_mask *mask) {
+    memory_free(mask->rows);
+    *mask = (Pixel_mask){0};
+}
+
+// x and y place the bottom left pixel of each mask, the rows both masks cover are shifted into
+// the columns of a and compared, one shift and one and per row
+bool pixel_mask_overlap(Pixel_mask *a, bool a_flipped, int32 a_x, int32 a_y, Pixel_mask *b, bool b_flipped, int32 b_x, int32 b_y) {
+    int32 dx = b_x - a_x, dy = b_y - a_y;
+    if (dx >= (int32) a->width || -dx >= (int32) b->width) return false;
+    int32 begin = (dy > 0) ? dy : 0;
+    int32 end = ((int32) a->height < dy + (int32) b->height) ? (int32) a->height : dy + (int32) b->height;
+
+    uint64 *rows_a = a_flipped ? a->mirrored : a->rows;
+    uint64 *rows_b = b_flipped ? b->mirrored : b->rows;
+    for (int32 y = begin; y < end; y++) {
+        uint64 row = rows_b[y - dy];
+        row = (dx >= 0) ? row << dx : row >> -dx;
+        if (rows_a[y] & row) return true;
+    }
+    return false;
+}
+
+// the box covers the pixels from min up to but not including max
+bool pixel_mask_overlap_box(Pixel_mask *mask, bool flipped, int32 x, int32 y, int32 min_x, int32 min_y, int32 max_x, int32 max_y) {
+    uint64 bits = row_bits(min_x - x, max_x - x) & row_bits(0, (int32) mask->width);
+    if (!bits) return false;
+    int32 begin = (min_y - y > 0) ? min_y - y : 0;
+    int32 end = (max_y - y < (int32) mask->height) ? max_y - y : (int32) mask->height;
+
+    uint64 *rows = flipped ? mask->mirrored : mask->rows;
+    for (int32 row = begin; row < end; row++) {
+        if (rows[row] & bits) return true;
+    }
+    return false;
+}
+
+// bits of the columns from begin up to end, clamped to a row
+static uint64 row_bits(int32 begin, int32 end) {
+    if (begin < 0) begin = 0;
+    if (end > PIXEL_MASK_MAX_WIDTH) end = PIXEL_MASK_MAX_WIDTH;
+    if (begin >= end) return 0;
+    uint64 below_end = (end == PIXEL_MASK_MAX_WIDTH) ? ~0ull : (1ull << end) - 1;
+    return below_end & ~((1ull << begin) - 1);
+}
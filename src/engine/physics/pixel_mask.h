@@ -0,0 +1,22 @@
+#ifndef PIXEL_MASK_H
+#define PIXEL_MASK_H
+
+#include "../types.h"
+
+#define PIXEL_MASK_MAX_WIDTH 64
+// pixels with at least this alpha are solid
+#define PIXEL_MASK_ALPHA_THRESHOLD 128
+
+// solid pixels of one sprite frame, bit x of a row is column x from the left
+// row 0 is the bottom row like the world, mirrored holds the rows of the horizontally flipped frame
+typedef struct pixel_mask {
+    uint32 width, height;
+    uint64 *rows, *mirrored;
+} Pixel_mask;
+
+bool pixel_mask_init(Pixel_mask *mask, uint8 *pixels, uint64 stride, uint32 channel_count, uint32 width, uint32 height);
+void pixel_mask_free(Pixel_mask *mask);
+bool pixel_mask_overlap(Pixel_mask *a, bool a_flipped, int32 a_x, int32 a_y, Pixel_mask *b, bool b_flipped, int32 b_x, int32 b_y);
+bool pixel_mask_overlap_box(Pixel_mask *mask, bool flipped, int32 x, int32 y, int32 min_x, int32 min_y, int32 max_x, int32 max_y);
+
+#endif // !PIXEL_MASK_H
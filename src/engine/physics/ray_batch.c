@@ -0,0 +1,204 @@
+#include <math.h>
+
+#include "ray_batch.h"
+#include "physics_fixed.h"
+
+// RAY_BATCH_SCALAR builds the fallback kernel on SSE2 targets as well, for ray_batch_test_scalar
+#if !defined(PHYSICS_FIXED_POINT) && !defined(RAY_BATCH_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define RAY_BATCH_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(PHYSICS_FIXED_POINT) && !defined(RAY_BATCH_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define RAY_BATCH_FIXED_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef PHYSICS_FIXED_POINT
+#ifdef RAY_BATCH_FIXED_SSE2
+static uint32 fixed_batch_reach(vec2 pos, vec2 magnitude, Ray_batch *batch);
+static __m128i fixed_lanes(float32 *values);
+static void fixed_lanes_widen(__m128i lanes, __m128i wide[2], bool absolute);
+static __m128i fixed_wide_set1(int64 value);
+#endif
+#else
+static void fill_hit(Collision *hit, vec2 pos, vec2 magnitude, Ray_batch *batch, uint32 lane, float32 last_entry);
+#endif
+
+void ray_batch_add(Ray_batch *batch, AABB *aabb) {
+    uint32 lane = batch->count++;
+    batch->pos_x[lane] = aabb->pos[0];
+    batch->pos_y[lane] = aabb->pos[1];
+    batch->half_x[lane] = aabb->half_size[0];
+    batch->half_y[lane] = aabb->half_size[1];
+}
+
+// slab test of one ray against every box in the batch, gives the same hits as ray_collide_aabb
+// fills hits for the lanes which collided and returns them as a bit mask
+uint32 ray_collide_aabb_batch(vec2 pos, vec2 magnitude, Ray_batch *batch, Collision hits[RAY_BATCH_WIDTH]) {
+    uint32 mask = 0;
+
+#ifdef PHYSICS_FIXED_POINT
+    // the fixed point slab test divides in 64 bits, which has no SIMD form, the integer lanes
+    // only drop the boxes the segment can't reach before the division
+    uint32 reach = (1u << batch->count) - 1;
+#ifdef RAY_BATCH_FIXED_SSE2
+    reach &= fixed_batch_reach(pos, magnitude, batch);
+#endif
+    for (uint32 lane = 0; lane < batch->count; lane++) {
+        if (!(reach & (1u << lane))) continue;
+        AABB aabb = {
+            .pos = {batch->pos_x[lane], batch->pos_y[lane]},
+            .half_size = {batch->half_x[lane], batch->half_y[lane]}
+        };
+        hits[lane] = fixed_ray_collide_aabb(pos, magnitude, aabb);
+        if (hits[lane].collided) mask |= 1u << lane;
+    }
+#else
+    float32 last_entry[RAY_BATCH_WIDTH];
+#ifdef RAY_BATCH_SSE2
+    // unused lanes get an empty box at the origin and are masked out at the end
+    for (uint32 lane = batch->count; lane < RAY_BATCH_WIDTH; lane++) {
+        batch->pos_x[lane] = batch->pos_y[lane] = 0;
+        batch->half_x[lane] = batch->half_y[lane] = 0;
+    }
+
+    __m128 pos_x = _mm_loadu_ps(batch->pos_x), pos_y = _mm_loadu_ps(batch->pos_y);
+    __m128 half_x = _mm_loadu_ps(batch->half_x), half_y = _mm_loadu_ps(batch->half_y);
+    __m128 min[2] = { _mm_sub_ps(pos_x, half_x), _mm_sub_ps(pos_y, half_y) };
+    __m128 max[2] = { _mm_add_ps(pos_x, half_x), _mm_add_ps(pos_y, half_y) };
+
+    __m128 entry = _mm_set1_ps(-INFINITY), exit = _mm_set1_ps(INFINITY);
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (uint8 i = 0; i < 2; i++) {
+        __m128 origin = _mm_set1_ps(pos[i]);
+        // the ray is the same for every lane so the branch is too
+        if (magnitude[i] != 0) {
+            __m128 length = _mm_set1_ps(magnitude[i]);
+            __m128 t1 = _mm_div_ps(_mm_sub_ps(min[i], origin), length);
+            __m128 t2 = _mm_div_ps(_mm_sub_ps(max[i], origin), length);
+
+            // fmaxf leaves the sign of a zero entry time to the libm, so only that sign can differ from it
+            entry = _mm_max_ps(_mm_min_ps(t1, t2), entry);
+            exit = _mm_min_ps(exit, _mm_max_ps(t1, t2));
+        }
+        else {
+            __m128 between = _mm_and_ps(_mm_cmpgt_ps(origin, min[i]), _mm_cmplt_ps(origin, max[i]));
+            inside = _mm_and_ps(inside, between);
+        }
+    }
+    __m128 collided = _mm_and_ps(inside, _mm_cmpgt_ps(exit, entry));
+    collided = _mm_and_ps(collided, _mm_cmpgt_ps(exit, _mm_setzero_ps()));
+    collided = _mm_and_ps(collided, _mm_cmplt_ps(entry, _mm_set1_ps(1)));
+
+    _mm_storeu_ps(last_entry, entry);
+    mask = (uint32) _mm_movemask_ps(collided) & ((1u << batch->count) - 1);
+#else
+    for (uint32 lane = 0; lane < batch->count; lane++) {
+        float32 min[2] = { batch->pos_x[lane] - batch->half_x[lane], batch->pos_y[lane] - batch->half_y[lane] };
+        float32 max[2] = { batch->pos_x[lane] + batch->half_x[lane], batch->pos_y[lane] + batch->half_y[lane] };
+        float32 entry = -INFINITY, exit = INFINITY;
+        bool inside = true;
+
+        for (uint8 i = 0; i < 2; i++) {
+            if (magnitude[i] != 0) {
+                float32 t1 = (min[i] - pos[i]) / magnitude[i];
+                float32 t2 = (max[i] - pos[i]) / magnitude[i];
+
+                entry = fmaxf(entry, fminf(t1, t2));
+                exit = fminf(exit, fmaxf(t1, t2));
+            }
+            else if (pos[i] <= min[i] || pos[i] >= max[i]) {
+                inside = false;
+            }
+        }
+        last_entry[lane] = entry;
+        if (inside && exit > entry && exit > 0 && entry < 1) mask |= 1u << lane;
+    }
+#endif
+
+    for (uint32 lane = 0; lane < batch->count; lane++) {
+        if (mask & (1u << lane)) fill_hit(&hits[lane], pos, magnitude, batch, lane, last_entry[lane]);
+    }
+#endif
+    return mask;
+}
+
+#ifdef RAY_BATCH_FIXED_SSE2
+// lanes whose box reaches into the bounds of the segment on both axes in Q16.16, fixed_ray_collide_aabb
+// can't hit any other box: its exit time is only above 0 when the far side of the box is past the start
+// of the segment and its entry time is only below 1 when the near side is before the end,
+// with either sign of the half size, the sums need 33 bits so the lanes are compared in 64 bits
+static uint32 fixed_batch_reach(vec2 pos, vec2 magnitude, Ray_batch *batch) {
+    // unused lanes get an empty box at the origin and are masked out by the caller
+    for (uint32 lane = batch->count; lane < RAY_BATCH_WIDTH; lane++) {
+        batch->pos_x[lane] = batch->pos_y[lane] = 0;
+        batch->half_x[lane] = batch->half_y[lane] = 0;
+    }
+
+    float32 *centers[2] = {batch->pos_x, batch->pos_y}, *halves[2] = {batch->half_x, batch->half_y};
+    // lanes 0 and 1 in the first register, 2 and 3 in the second
+    __m128i inside[2] = {_mm_set1_epi32(-1), _mm_set1_epi32(-1)};
+    for (uint8 i = 0; i < 2; i++) {
+        int64 origin = fixed_from_float(pos[i]), end = origin + fixed_from_float(magnitude[i]);
+        __m128i segment_min = fixed_wide_set1((origin < end) ? origin : end);
+        __m128i segment_max = fixed_wide_set1((origin < end) ? end : origin);
+        __m128i center[2], half_size[2];
+        fixed_lanes_widen(fixed_lanes(centers[i]), center, false);
+        fixed_lanes_widen(fixed_lanes(halves[i]), half_size, true);
+        for (uint8 w = 0; w < 2; w++) {
+            // the sign bits of segment_min - far side and near side - segment_max
+            __m128i past_start = _mm_sub_epi64(segment_min, _mm_add_epi64(center[w], half_size[w]));
+            __m128i before_end = _mm_sub_epi64(_mm_sub_epi64(center[w], half_size[w]), segment_max);
+            inside[w] = _mm_and_si128(inside[w], _mm_and_si128(past_start, before_end));
+        }
+    }
+    return (uint32) _mm_movemask_pd(_mm_castsi128_pd(inside[0])) |
+           (uint32) _mm_movemask_pd(_mm_castsi128_pd(inside[1])) << 2;
+}
+
+// fixed_from_float of four floats
+static __m128i fixed_lanes(float32 *values) {
+    __m128 scaled = _mm_mul_ps(_mm_loadu_ps(values), _mm_set1_ps(FIXED_ONE));
+    return _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(scaled, _mm_set1_ps(FIXED_SCALED_MIN)), _mm_set1_ps(FIXED_SCALED_MAX)));
+}
+
+// sign extends the four lanes into two registers of 64 bit lanes, or takes their absolute value
+static void fixed_lanes_widen(__m128i lanes, __m128i wide[2], bool absolute) {
+    __m128i sign = _mm_srai_epi32(lanes, 31);
+    wide[0] = _mm_unpacklo_epi32(lanes, sign);
+    wide[1] = _mm_unpackhi_epi32(lanes, sign);
+    if (!absolute) return;
+    for (uint8 w = 0; w < 2; w++) {
+        __m128i wide_sign = _mm_shuffle_epi32(wide[w], _MM_SHUFFLE(3, 3, 1, 1));
+        wide_sign = _mm_srai_epi32(wide_sign, 31);
+        wide[w] = _mm_sub_epi64(_mm_xor_si128(wide[w], wide_sign), wide_sign);
+    }
+}
+
+// _mm_set1_epi64x is missing on 32 bit MSVC
+static __m128i fixed_wide_set1(int64 value) {
+    int32 low = (int32) (uint32) value, high = (int32) (value >> 32);
+    return _mm_set_epi32(high, low, high, low);
+}
+#endif
+
+#ifndef PHYSICS_FIXED_POINT
+static void fill_hit(Collision *hit, vec2 pos, vec2 magnitude, Ray_batch *batch, uint32 lane, float32 last_entry) {
+    *hit = (Collision){0};
+    hit->pos[0] = pos[0] + magnitude[0] * last_entry;
+    hit->pos[1] = pos[1] + magnitude[1] * last_entry;
+    hit->collided = true;
+    hit->time = last_entry;
+
+    float32 dx = hit->pos[0] - batch->pos_x[lane];
+    float32 dy = hit->pos[1] - batch->pos_y[lane];
+    float32 px = batch->half_x[lane] - fabsf(dx);
+    float32 py = batch->half_y[lane] - fabsf(dy);
+
+    // set normal for the direction of collision
+    if (px < py)
+        hit->normal[0] = (dx > 0) - (dx < 0);
+    else
+        hit->normal[1] = (dy > 0) - (dy < 0);
+}
+#endif
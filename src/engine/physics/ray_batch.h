@@ -0,0 +1,20 @@
+#ifndef RAY_BATCH_H
+#define RAY_BATCH_H
+
+#include <linmath.h>
+#include "../types.h"
+#include "physics.h"
+
+#define RAY_BATCH_WIDTH 4
+
+// boxes tested against one ray at a time, stored by lane
+typedef struct ray_batch {
+    float32 pos_x[RAY_BATCH_WIDTH], pos_y[RAY_BATCH_WIDTH];
+    float32 half_x[RAY_BATCH_WIDTH], half_y[RAY_BATCH_WIDTH];
+    uint32 count;
+} Ray_batch;
+
+void ray_batch_add(Ray_batch *batch, AABB *aabb);
+uint32 ray_collide_aabb_batch(vec2 pos, vec2 magnitude, Ray_batch *batch, Collision hits[RAY_BATCH_WIDTH]);
+
+#endif // !RAY_BATCH_H
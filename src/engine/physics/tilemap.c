@@ -0,0 +1,162 @@
+#define MEMORY_TAG MEMORY_TAG_PHYSICS
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tilemap.h"
+#include "physics.h"
+#include "../utils.h"
+
+static uint32 tile_layer(Tilemap *map, uint32 x, uint32 y);
+static void chunk_build(Tilemap *map, uint32 chunk_x, uint32 chunk_y);
+static void chunk_clear(Tilemap *map, uint32 chunk);
+
+bool tilemap_init(Tilemap *map, uint32 width, uint32 height, float32 tile_size, vec2 origin) {
+    *map = (Tilemap){
+        .width = width, .height = height, .tile_size = tile_size,
+        .origin = {origin[0], origin[1]},
+        .chunks_x = (width + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE,
+        .chunks_y = (height + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE
+    };
+    uint32 chunk_count = map->chunks_x * map->chunks_y;
+    map->tiles = memory_calloc(MEMORY_TAG, (uint64) width * height, sizeof(uint8));
+    map->chunk_bodies = memory_calloc(MEMORY_TAG, chunk_count, sizeof(List *));
+    map->chunk_dirty = memory_calloc(MEMORY_TAG, chunk_count, sizeof(bool));
+    if ((width * height > 0 && !map->tiles) || (chunk_count > 0 && (!map->chunk_bodies || !map->chunk_dirty))) {
+        memory_free(map->tiles);
+        memory_free(map->chunk_bodies);
+        memory_free(map->chunk_dirty);
+        *map = (Tilemap){0};
+        ERROR_RETURN(false, "Unable to allocate memory for tilemap\n");
+    }
+    for (uint32 i = 0; i < chunk_count; i++)
+        map->chunk_bodies[i] = list_create(0, sizeof(uint32));
+    return true;
+}
+
+// destroys every static body the map made
+void tilemap_exit(Tilemap *map) {
+    for (uint32 i = 0; i < map->chunks_x * map->chunks_y; i++) {
+        chunk_clear(map, i);
+        list_delete(map->chunk_bodies[i]);
+    }
+    memory_free(map->tiles);
+    memory_free(map->chunk_bodies);
+    memory_free(map->chunk_dirty);
+    *map = (Tilemap){0};
+}
+
+// marks every chunk with tiles of this id for the next build
+void tilemap_tile_layer_set(Tilemap *map, uint8 tile_id, uint32 collision_layer) {
+    if (map->tile_layers[tile_id] == collision_layer) return;
+    map->tile_layers[tile_id] = collision_layer;
+    for (uint32 y = 0; y < map->height; y++) {
+        for (uint32 x = 0; x < map->width; x++) {
+            if (map->tiles[(uint64) y * map->width + x] == tile_id)
+                map->chunk_dirty[(y / TILEMAP_CHUNK_SIZE) * map->chunks_x + x / TILEMAP_CHUNK_SIZE] = true;
+        }
+    }
+}
+
+void tilemap_tile_set(Tilemap *map, uint32 x, uint32 y, uint8 tile_id) {
+    if (x >= map->width || y >= map->height) {
+        ERROR_RETURN(, "Cannot set tile outside of tilemap\n");
+    }
+    uint32 old_layer = tile_layer(map, x, y);
+    map->tiles[(uint64) y * map->width + x] = tile_id;
+    // only a change of the collision layer changes the rectangles
+    if (tile_layer(map, x, y) != old_layer)
+        map->chunk_dirty[(y / TILEMAP_CHUNK_SIZE) * map->chunks_x + x / TILEMAP_CHUNK_SIZE] = true;
+}
+
+uint8 tilemap_tile_get(Tilemap *map, uint32 x, uint32 y) {
+    if (x >= map->width || y >= map->height) {
+        ERROR_RETURN(0, "Cannot get tile outside of tilemap\n");
+    }
+    return map->tiles[(uint64) y * map->width + x];
+}
+
+// replaces the static bodies of every changed chunk, returns how many chunks were rebuilt
+// the new bodies take the slots the old ones freed, so the static tree is only refit around the chunk
+// unless it now needs more bodies than there are free slots
+uint64 tilemap_build(Tilemap *map) {
+    uint64 rebuilt = 0;
+    for (uint32 chunk_y = 0; chunk_y < map->chunks_y; chunk_y++) {
+        for (uint32 chunk_x = 0; chunk_x < map->chunks_x; chunk_x++) {
+            uint32 chunk = chunk_y * map->chunks_x + chunk_x;
+            if (!map->chunk_dirty[chunk]) continue;
+            chunk_clear(map, chunk);
+            chunk_build(map, chunk_x, chunk_y);
+            map->chunk_dirty[chunk] = false;
+            rebuilt++;
+        }
+    }
+    return rebuilt;
+}
+
+uint64 tilemap_static_body_count(Tilemap *map) {
+    uint64 count = 0;
+    for (uint32 i = 0; i < map->chunks_x * map->chunks_y; i++)
+        count += map->chunk_bodies[i]->len;
+    return count;
+}
+
+static uint32 tile_layer(Tilemap *map, uint32 x, uint32 y) {
+    uint8 tile_id = map->tiles[(uint64) y * map->width + x];
+    return (tile_id == 0) ? 0 : map->tile_layers[tile_id];
+}
+
+// greedy meshing, every free tile grows a rectangle to the right as far as the layer goes
+// and then upwards while the whole row below it matches, tiles of different layers never merge
+static void chunk_build(Tilemap *map, uint32 chunk_x, uint32 chunk_y) {
+    uint32 x0 = chunk_x * TILEMAP_CHUNK_SIZE, y0 = chunk_y * TILEMAP_CHUNK_SIZE;
+    uint32 x1 = x0 + TILEMAP_CHUNK_SIZE, y1 = y0 + TILEMAP_CHUNK_SIZE;
+    if (x1 > map->width) x1 = map->width;
+    if (y1 > map->height) y1 = map->height;
+
+    bool used[TILEMAP_CHUNK_SIZE][TILEMAP_CHUNK_SIZE] = {0};
+    List *bodies = map->chunk_bodies[chunk_y * map->chunks_x + chunk_x];
+    for (uint32 y = y0; y < y1; y++) {
+        for (uint32 x = x0; x < x1; x++) {
+            uint32 layer = tile_layer(map, x, y);
+            if (layer == 0 || used[y - y0][x - x0]) continue;
+
+            uint32 end_x = x + 1;
+            while (end_x < x1 && !used[y - y0][end_x - x0] && tile_layer(map, end_x, y) == layer)
+                end_x++;
+
+            uint32 end_y = y + 1;
+            for (; end_y < y1; end_y++) {
+                uint32 i = x;
+                while (i < end_x && !used[end_y - y0][i - x0] && tile_layer(map, i, end_y) == layer)
+                    i++;
+                if (i < end_x) break;
+            }
+
+            for (uint32 j = y; j < end_y; j++)
+                for (uint32 i = x; i < end_x; i++)
+                    used[j - y0][i - x0] = true;
+
+            Body_data data = {
+                .pos = {
+                    map->origin[0] + (x + end_x) * 0.5f * map->tile_size,
+                    map->origin[1] + (y + end_y) * 0.5f * map->tile_size
+                },
+                .size = {(end_x - x) * map->tile_size, (end_y - y) * map->tile_size},
+                .collision_layer = layer
+            };
+            uint64 static_body_id = physics_static_body_create(data);
+            if (static_body_id == -1) continue;
+            uint32 id = (uint32) static_body_id;
+            list_append(bodies, &id);
+        }
+    }
+}
+
+static void chunk_clear(Tilemap *map, uint32 chunk) {
+    List *bodies = map->chunk_bodies[chunk];
+    uint32 *ids = bodies->items;
+    for (uint64 i = 0; i < bodies->len; i++)
+        physics_static_body_destroy(ids[i]);
+    bodies->len = 0;
+}
@@ -0,0 +1,34 @@
+#ifndef TILEMAP_H
+#define TILEMAP_H
+
+#include <linmath.h>
+#include "../types.h"
+#include "../list.h"
+
+// tiles a chunk covers in each direction, rectangles never cross chunk borders
+// so a changed tile only rebuilds the static bodies of its own chunk
+#define TILEMAP_CHUNK_SIZE 32
+
+// grid of tile ids turned into static bodies, 0 is an empty tile and every other id
+// collides on the layer set with tilemap_tile_layer_set, tiles without a layer don't collide
+// row 0 is the bottom row and starts at origin, y grows upwards like the world
+typedef struct tilemap {
+    uint32 width, height;
+    float32 tile_size;
+    vec2 origin;
+    uint8 *tiles;           // width * height tile ids, row by row
+    uint32 tile_layers[256]; // collision layer of each tile id
+    uint32 chunks_x, chunks_y;
+    List **chunk_bodies;    // uint32 static body ids made for each chunk
+    bool *chunk_dirty;
+} Tilemap;
+
+bool tilemap_init(Tilemap *map, uint32 width, uint32 height, float32 tile_size, vec2 origin);
+void tilemap_exit(Tilemap *map);
+void tilemap_tile_layer_set(Tilemap *map, uint8 tile_id, uint32 collision_layer);
+void tilemap_tile_set(Tilemap *map, uint32 x, uint32 y, uint8 tile_id);
+uint8 tilemap_tile_get(Tilemap *map, uint32 x, uint32 y);
+uint64 tilemap_build(Tilemap *map);
+uint64 tilemap_static_body_count(Tilemap *map);
+
+#endif // !TILEMAP_H
@@ -1,10 +1,18 @@
+#define MEMORY_TAG MEMORY_TAG_RENDER
+
 #include <stddef.h>
 #include <glad/glad.h>
+#include "../memory.h"
+// decoded images are charged to rendering until stbi_image_free
+#define STBI_MALLOC(size) memory_alloc(MEMORY_TAG_RENDER, size)
+#define STBI_REALLOC(ptr, size) memory_realloc(MEMORY_TAG_RENDER, ptr, size)
+#define STBI_FREE(ptr) memory_free(ptr)
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
 #include "renderer.h"
 #include "renderer_internal.h"
+#include "../arena.h"
 #include "../utils.h"
 
 uint32 vao_quad, vbo_quad, ebo_quad;
@@ -19,6 +27,8 @@ List *batch_vert_list = NULL;
 
 static uint32 batch_texture_ids[8] = {0};
 
+static void bake_sprite_sheet_masks(Sprite_sheet *sheet, uint8 *image_data, int32 channel_count);
+
 SDL_Window *render_init(void) {
     SDL_Window *window = create_window(window_width, window_height);
     if (!window) {
@@ -40,7 +50,8 @@ SDL_Window *render_init(void) {
 void render_begin(void) {
     glClearColor(0.08, 0.1, 0.1, 1.0);
     glClear(GL_COLOR_BUFFER_BIT);
-    batch_vert_list->len = 0;
+    list_clear(batch_vert_list);
+    frame_arena_begin();
 }
 
 void render_end(SDL_Window *window, float32 *m_width, float32 *m_height) {
@@ -206,10 +217,48 @@ void render_load_sprite_sheet(Sprite_sheet *sheet, const char *path, float32 cel
         ERROR_EXIT_PROGRAM("Failed to load image : %s.\n", path);
     }
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image_data);
-    stbi_image_free(image_data);
 
     sheet->width = (float32) width;
     sheet->height = (float32) height;
     sheet->cell_width = cell_width;
     sheet->cell_height = cell_height;
+    sheet->columns = (uint32) (width / cell_width);
+    sheet->rows = (uint32) (height / cell_height);
+    sheet->masks = NULL;
+    bake_sprite_sheet_masks(sheet, image_data, channel_count);
+    stbi_image_free(image_data);
+}
+
+Pixel_mask *render_sprite_sheet_mask(Sprite_sheet *sheet, uint8 row, uint8 col) {
+    if (!sheet->masks || row >= sheet->rows || col >= sheet->columns) return NULL;
+    return &sheet->masks[row * sheet->columns + col];
+}
+
+void render_free_sprite_sheet(Sprite_sheet *sheet) {
+    glDeleteTextures(1, &sheet->texture_id);
+    if (sheet->masks) {
+        for (uint32 i = 0; i < sheet->columns * sheet->rows; i++) {
+            pixel_mask_free(&sheet->masks[i]);
+        }
+        memory_free(sheet->masks);
+        sheet->masks = NULL;
+    }
+}
+
+// image rows are flipped on load so cell row 0 starts at the first image row like the uvs
+static void bake_sprite_sheet_masks(Sprite_sheet *sheet, uint8 *image_data, int32 channel_count) {
+    uint32 cell_width = (uint32) sheet->cell_width, cell_height = (uint32) sheet->cell_height;
+    if (cell_width == 0 || cell_width > PIXEL_MASK_MAX_WIDTH || sheet->columns * sheet->rows == 0) return;
+
+    sheet->masks = memory_calloc(MEMORY_TAG, sheet->columns * sheet->rows, sizeof(Pixel_mask));
+    if (!sheet->masks) {
+        ERROR_RETURN((void) 0, "Unable to allocate memory for sprite sheet masks\n");
+    }
+    uint64 stride = (uint64) sheet->width * channel_count;
+    for (uint32 row = 0; row < sheet->rows; row++) {
+        for (uint32 col = 0; col < sheet->columns; col++) {
+            uint8 *cell = image_data + row * cell_height * stride + col * cell_width * channel_count;
+            pixel_mask_init(&sheet->masks[row * sheet->columns + col], cell, stride, channel_count, cell_width, cell_height);
+        }
+    }
 }
@@ -5,12 +5,16 @@
 #include <linmath.h>
 
 #include "../physics/physics.h"
+#include "../physics/pixel_mask.h"
 #include "../types.h"
 
 typedef struct sprite_sheet {
     float32 width, height;
     float32 cell_width, cell_height;
     uint32 texture_id;
+    // one collision mask per cell, row major from the bottom row, NULL when cells are too wide to bake
+    Pixel_mask *masks;
+    uint32 columns, rows;
 } Sprite_sheet;
 
 SDL_Window *render_init(void);
@@ -26,5 +30,7 @@ void render_batch(uint32 count, uint32 texture_id[]);
 
 void render_load_sprite_sheet(Sprite_sheet *sheet, const char *path, float32 cell_width, float32 cell_height);
 void render_sprite_sheet_frame(Sprite_sheet *sheet, float32 row, float32 col, vec2 pos, vec2 size, vec4 color, bool is_flipped);
+Pixel_mask *render_sprite_sheet_mask(Sprite_sheet *sheet, uint8 row, uint8 col);
+void render_free_sprite_sheet(Sprite_sheet *sheet);
 
 #endif // !RENDERER_H
@@ -1,3 +1,5 @@
+#define MEMORY_TAG MEMORY_TAG_RENDER
+
 #include <glad/glad.h>
 #include <stdio.h>
 #include <stddef.h>
@@ -97,30 +99,24 @@ void append_batch_quad(vec2 pos, vec2 size, vec4 uv, vec4 color, int32 texture_s
     if (texture_slot == -1)
         texture_slot = 0;
 
-    list_append(batch_vert_list, &(B_vertex){
-        .pos = {pos[0], pos[1]},
-        .uv = {default_uv[0], default_uv[1]},
-        .color = {color[0], color[1], color[2], color[3]},
-        .texture_slot = texture_slot
-    });
-    list_append(batch_vert_list, &(B_vertex){
-        .pos = {pos[0] + size[0], pos[1]},
-        .uv = {default_uv[2], default_uv[1]},
-        .color = {color[0], color[1], color[2], color[3]},
-        .texture_slot = texture_slot
-    });
-    list_append(batch_vert_list, &(B_vertex){
-        .pos = {pos[0] + size[0], pos[1] + size[1]},
-        .uv = {default_uv[2], default_uv[3]},
-        .color = {color[0], color[1], color[2], color[3]},
-        .texture_slot = texture_slot
-    });
-    list_append(batch_vert_list, &(B_vertex){
-        .pos = {pos[0], pos[1] + size[1]},
-        .uv = {default_uv[0], default_uv[3]},
-        .color = {color[0], color[1], color[2], color[3]},
-        .texture_slot = texture_slot
-    });
+    // the four corners are written straight into the batch
+    B_vertex *vertices = list_emplace(batch_vert_list, 4);
+    if (!vertices) return;
+    float32 corners[4][4] = {
+        {pos[0], pos[1], default_uv[0], default_uv[1]},
+        {pos[0] + size[0], pos[1], default_uv[2], default_uv[1]},
+        {pos[0] + size[0], pos[1] + size[1], default_uv[2], default_uv[3]},
+        {pos[0], pos[1] + size[1], default_uv[0], default_uv[3]}
+    };
+    for (uint32 i = 0; i < 4; i++) {
+        B_vertex *vertex = &vertices[i];
+        vertex->pos[0] = corners[i][0];
+        vertex->pos[1] = corners[i][1];
+        vertex->uv[0] = corners[i][2];
+        vertex->uv[1] = corners[i][3];
+        vec4_dup(vertex->color, color);
+        vertex->texture_slot = texture_slot;
+    }
 }
 
 void render_shaders_init(void) {
@@ -146,7 +142,7 @@ void render_shaders_init(void) {
         );
     }
     glUseProgram(0);
-    batch_vert_list = list_create(8, sizeof(B_vertex));
+    batch_vert_list = list_create(MAX_VERTICES, sizeof(B_vertex));
 }
 
 void render_textures_init(uint32 *texture) {
@@ -79,8 +79,8 @@ uint32 shader_create(const char *vert_shader_path, const char *frag_shader_path)
     glDeleteShader(vert_shader);
     glDeleteShader(frag_shader);
 
-    free(vert_shader_src.data);
-    free(frag_shader_src.data);
+    memory_free(vert_shader_src.data);
+    memory_free(frag_shader_src.data);
     return shader;
 }
 
@@ -0,0 +1,98 @@
+#include "slot_map.h"
+#include "utils.h"
+
+bool slot_map_init_tagged(Slot_map *map, uint64 capacity, Memory_tag tag) {
+    *map = (Slot_map){.free_head = SLOT_MAP_NONE};
+    map->slots = list_create_tagged(capacity, sizeof(Slot), tag);
+    return map->slots != NULL;
+}
+
+// returns the handle of a free slot, a slot index equal to the length the map had before is a new slot
+// and the owner appends an item for it, -1 when the map can't grow
+uint64 slot_map_alloc(Slot_map *map) {
+    Slot *slots = map->slots->items;
+    uint32 index = map->free_head;
+    if (index != SLOT_MAP_NONE) {
+        map->free_head = slots[index].next_free;
+    }
+    else {
+        ASSERT_RETURN(map->slots->len < SLOT_MAP_NONE, -1, "Slot map is full\n");
+        uint64 appended = list_append(map->slots, &(Slot){.generation = 0, .next_free = SLOT_MAP_NONE});
+        if (appended == -1) return -1;
+        index = (uint32) appended;
+        slots = map->slots->items;
+    }
+    slots[index].generation++;
+    slots[index].next_free = SLOT_MAP_NONE;
+    map->count++;
+    return SLOT_HANDLE(index, slots[index].generation);
+}
+
+// false when the handle is stale, the slot is then left alone
+bool slot_map_release(Slot_map *map, uint64 handle) {
+    if (!slot_map_valid(map, handle)) return false;
+    Slot *slot = (Slot *) map->slots->items + SLOT_HANDLE_INDEX(handle);
+    slot->generation++;
+    slot->next_free = map->free_head;
+    map->free_head = SLOT_HANDLE_INDEX(handle);
+    map->count--;
+    return true;
+}
+
+bool slot_map_valid(Slot_map *map, uint64 handle) {
+    uint32 index = SLOT_HANDLE_INDEX(handle);
+    if (index >= map->slots->len) return false;
+    uint32 generation = SLOT_HANDLE_GENERATION(handle);
+    return (generation & 1) && ((Slot *) map->slots->items)[index].generation == generation;
+}
+
+// handle of the item in a slot for code walking the items by index, -1 when the slot is free
+uint64 slot_map_handle(Slot_map *map, uint64 index) {
+    if (index >= map->slots->len) return -1;
+    uint32 generation = ((Slot *) map->slots->items)[index].generation;
+    return (generation & 1) ? SLOT_HANDLE(index, generation) : (uint64) -1;
+}
+
+bool slot_map_copy(Slot_map *dest, Slot_map *src) {
+    if (!list_copy(dest->slots, src->slots)) return false;
+    dest->free_head = src->free_head;
+    dest->count = src->count;
+    return true;
+}
+
+// slot_map_copy for rolling back to src, a slot free in src keeps the newest generation either map had for it
+// so handles given out after src was copied never become valid again, the slots dest has past the end of src
+// are freed and follow the free slots of src in ascending order, a replay then gets the indices of the run it repeats
+bool slot_map_restore(Slot_map *dest, Slot_map *src) {
+    uint64 dest_len = dest->slots->len, src_len = src->slots->len;
+    if (!list_reserve(dest->slots, src_len)) return false;
+    Slot *slots = dest->slots->items, *src_slots = src->slots->items;
+    for (uint64 i = 0; i < src_len; i++) {
+        Slot slot = src_slots[i];
+        if (i < dest_len && !(slot.generation & 1) && slots[i].generation > slot.generation)
+            slot.generation = slots[i].generation + (slots[i].generation & 1);
+        slots[i] = slot;
+    }
+    dest->free_head = src->free_head;
+    dest->count = src->count;
+    if (dest_len <= src_len) {
+        dest->slots->len = src_len;
+        return true;
+    }
+
+    uint32 *tail = &dest->free_head;
+    while (*tail != SLOT_MAP_NONE)
+        tail = &slots[*tail].next_free;
+    for (uint64 i = src_len; i < dest_len; i++) {
+        slots[i].generation += slots[i].generation & 1;
+        *tail = (uint32) i;
+        tail = &slots[i].next_free;
+    }
+    *tail = SLOT_MAP_NONE;
+    return true;
+}
+
+void slot_map_free(Slot_map *map) {
+    list_delete(map->slots);
+    *map = (Slot_map){.free_head = SLOT_MAP_NONE};
+}
@@ -0,0 +1,41 @@
+#ifndef SLOT_MAP_H
+#define SLOT_MAP_H
+
+#include "types.h"
+#include "list.h"
+
+// a handle is the slot index in the low 32 bits and the generation of the slot in the high 32 bits,
+// releasing a slot changes its generation so handles to the old item stop being valid once it is reused
+#define SLOT_HANDLE(index, generation) (((uint64) (generation) << 32) | (uint32) (index))
+#define SLOT_HANDLE_INDEX(handle) ((uint32) (handle))
+#define SLOT_HANDLE_GENERATION(handle) ((uint32) ((handle) >> 32))
+
+// end of the free list, also the one index a slot never has so no handle is -1
+#define SLOT_MAP_NONE UINT32_MAX
+
+// generation is odd while the slot is in use and even while it is free,
+// next_free links the free slots through the slots themselves
+typedef struct slot {
+    uint32 generation, next_free;
+} Slot;
+
+// hands out slot indices for a list of items kept by the owner, freed slots are reused first
+typedef struct slot_map {
+    List *slots;
+    uint32 free_head;
+    uint64 count;       // slots in use
+} Slot_map;
+
+// the slots are charged to the MEMORY_TAG of the file creating the map
+#define slot_map_init(map, capacity) slot_map_init_tagged(map, capacity, MEMORY_TAG)
+
+bool slot_map_init_tagged(Slot_map *map, uint64 capacity, Memory_tag tag);
+uint64 slot_map_alloc(Slot_map *map);
+bool slot_map_release(Slot_map *map, uint64 handle);
+bool slot_map_valid(Slot_map *map, uint64 handle);
+uint64 slot_map_handle(Slot_map *map, uint64 index);
+bool slot_map_copy(Slot_map *dest, Slot_map *src);
+bool slot_map_restore(Slot_map *dest, Slot_map *src);
+void slot_map_free(Slot_map *map);
+
+#endif // !SLOT_MAP_H
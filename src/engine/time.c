@@ -2,7 +2,8 @@
 
 #include "time.h"
 #include "global.h"
-#include "list.h"
+#include "array.h"
+#include "slot_map.h"
 #include "utils.h"
 
 #ifdef _WIN32
@@ -11,12 +12,18 @@
 #include <unistd.h>
 #endif
 
-static List *timer_list;
+ARRAY_DEFINE(Timer)
+
+static Array_Timer timer_list;
+static Slot_map timer_slots;
+
+static Timer *timer_get(uint64 timer_id);
 
 void time_init(uint32 frame_rate) {
     timing.frame_rate = frame_rate;
     timing.frame_delay = (frame_rate == 0) ? 0 : 1000.0 / (float32) frame_rate;
-    timer_list = list_create(0, sizeof(Timer));
+    timer_list = (Array_Timer){0};
+    slot_map_init(&timer_slots, 0);
 }
 
 void time_update(void) {
@@ -24,8 +31,8 @@ void time_update(void) {
     timing.now = (float32) SDL_GetTicks64();
     timing.delta = (timing.now - timing.last) / 1000.0;
     Timer *timer;
-    for (uint64 i = 0; i < timer_list->len; i++) {
-        timer = list_get(timer_list, i);
+    for (uint64 i = 0; i < timer_list.len; i++) {
+        timer = array_Timer_at(&timer_list, i);
         if (timer->running) {
             float32 delta = timing.now - timer->current_time;
             timer->time_left -= delta;
@@ -46,21 +53,15 @@ void time_update(void) {
 }
 
 uint64 timer_create(float32 duration, bool start_now) {
-    uint64 id = timer_list->len;
-    for (uint64 i = 0; i < timer_list->len; i++) {
-        Timer *timer = list_get(timer_list, i);
-        if (!timer->active) {
-            id = i;
-            break;
-        }
-    }
+    uint64 id = slot_map_alloc(&timer_slots);
+    ASSERT_RETURN(id != -1, -1, "Unable to create timer\n");
 
-    if (id == timer_list->len) {
-        uint64 timer_id = list_append(timer_list, &(Timer){0});
-        ASSERT_RETURN(timer_id != -1, -1, "Unable to create timer\n");
+    if (SLOT_HANDLE_INDEX(id) == timer_list.len) {
+        Timer *slot = array_Timer_emplace_back(&timer_list);
+        ASSERT_RETURN(slot, -1, "Unable to create timer\n");
     }
 
-    Timer *timer = list_get(timer_list, id);
+    Timer *timer = array_Timer_at(&timer_list, SLOT_HANDLE_INDEX(id));
     *timer = (Timer){
         .running = start_now, .complete = false, .active = true,
         .duration = duration, .time_left = duration, .current_time = (float32) SDL_GetTicks64()
@@ -69,15 +70,18 @@ uint64 timer_create(float32 duration, bool start_now) {
     return id;
 }
 
+// the timer functions ignore handles of destroyed timers
 void timer_start(uint64 timer_id) {
-    Timer *timer = list_get(timer_list, timer_id);
+    Timer *timer = timer_get(timer_id);
+    if (!timer) return;
     timer->running = true;
     timer->complete = false;
     timer->current_time = (float32) SDL_GetTicks64();
 }
 
 void timer_restart(uint64 timer_id) {
-    Timer *timer = list_get(timer_list, timer_id);
+    Timer *timer = timer_get(timer_id);
+    if (!timer) return;
     timer->running = true;
     timer->complete = false;
     timer->time_left = timer->duration;
@@ -85,18 +89,27 @@ void timer_restart(uint64 timer_id) {
 }
 
 bool timer_check_complete(uint64 timer_id) {
-    Timer *timer = list_get(timer_list, timer_id);
-    return timer->complete;
+    Timer *timer = timer_get(timer_id);
+    return timer && timer->complete;
 }
 
 void timer_stop(uint64 timer_id) {
-    Timer *timer = list_get(timer_list, timer_id);
+    Timer *timer = timer_get(timer_id);
+    if (!timer) return;
     timer->running = false;
 }
 
 void timer_destroy(uint64 timer_id) {
-    Timer *timer = list_get(timer_list, timer_id);
+    Timer *timer = timer_get(timer_id);
+    if (!timer) return;
+    slot_map_release(&timer_slots, timer_id);
     timer->active = false;
+    timer->running = false;
+}
+
+static Timer *timer_get(uint64 timer_id) {
+    if (!slot_map_valid(&timer_slots, timer_id)) return NULL;
+    return array_Timer_at(&timer_list, SLOT_HANDLE_INDEX(timer_id));
 }
 
 void time_update_end(void) {
@@ -107,7 +120,8 @@ void time_update_end(void) {
 }
 
 void time_exit(void) {
-    list_delete(timer_list);
+    array_Timer_free(&timer_list);
+    slot_map_free(&timer_slots);
 }
 
 void time_delay(uint32 time_ms) {
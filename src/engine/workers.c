@@ -0,0 +1,184 @@
+#include <stdbool.h>
+
+#include "workers.h"
+#include "utils.h"
+
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE Thread;
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE Condition;
+#define mutex_init(m) InitializeCriticalSection(m)
+#define mutex_destroy(m) DeleteCriticalSection(m)
+#define mutex_lock(m) EnterCriticalSection(m)
+#define mutex_unlock(m) LeaveCriticalSection(m)
+#define condition_init(c) InitializeConditionVariable(c)
+#define condition_destroy(c) (void) 0
+#define condition_wait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define condition_broadcast(c) WakeAllConditionVariable(c)
+#else
+#include <pthread.h>
+#include <unistd.h>
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t Condition;
+#define mutex_init(m) pthread_mutex_init(m, NULL)
+#define mutex_destroy(m) pthread_mutex_destroy(m)
+#define mutex_lock(m) pthread_mutex_lock(m)
+#define mutex_unlock(m) pthread_mutex_unlock(m)
+#define condition_init(c) pthread_cond_init(c, NULL)
+#define condition_destroy(c) pthread_cond_destroy(c)
+#define condition_wait(c, m) pthread_cond_wait(c, m)
+#define condition_broadcast(c) pthread_cond_broadcast(c)
+#endif
+
+typedef struct workers_state {
+    Thread threads[WORKERS_MAX];
+    uint32 thread_count;
+    Mutex mutex;
+    Condition start, done;
+    // current run, jobs are handed out in order to whichever thread asks first
+    Worker_job job;
+    void *data;
+    uint64 job_count, next_job;
+    uint32 busy;
+    uint64 generation;
+    bool running;
+} Workers_state;
+
+static Workers_state state;
+
+static uint32 processor_count(void);
+static void run_jobs(uint32 worker_index);
+#ifdef _WIN32
+static DWORD WINAPI worker_main(LPVOID arg);
+#else
+static void *worker_main(void *arg);
+#endif
+
+// thread_count 0 uses one thread per processor
+void workers_init(uint32 thread_count) {
+    if (thread_count == 0) thread_count = processor_count();
+    if (thread_count > WORKERS_MAX) thread_count = WORKERS_MAX;
+
+    mutex_init(&state.mutex);
+    condition_init(&state.start);
+    condition_init(&state.done);
+    state.running = true;
+    state.generation = 0;
+
+    // the calling thread is worker 0
+    state.thread_count = 0;
+    for (uint32 i = 1; i < thread_count; i++) {
+        void *arg = (void *) (uintptr_t) i;
+#ifdef _WIN32
+        Thread thread = CreateThread(NULL, 0, worker_main, arg, 0, NULL);
+        if (!thread) {
+#else
+        Thread thread;
+        if (pthread_create(&thread, NULL, worker_main, arg) != 0) {
+#endif
+            ERROR_EXIT("Unable to create worker thread %u\n", i);
+            break;
+        }
+        state.threads[state.thread_count++] = thread;
+    }
+}
+
+uint32 workers_count(void) {
+    return state.thread_count + 1;
+}
+
+// runs job for every index in [0, job_count) and returns once all of them are done
+void workers_run(Worker_job job, void *data, uint64 job_count) {
+    if (state.thread_count == 0 || job_count <= 1) {
+        for (uint64 i = 0; i < job_count; i++) job(data, 0, i);
+        return;
+    }
+
+    mutex_lock(&state.mutex);
+    state.job = job;
+    state.data = data;
+    state.job_count = job_count;
+    state.next_job = 0;
+    state.busy = state.thread_count;
+    state.generation++;
+    condition_broadcast(&state.start);
+    mutex_unlock(&state.mutex);
+
+    run_jobs(0);
+
+    mutex_lock(&state.mutex);
+    while (state.busy > 0) condition_wait(&state.done, &state.mutex);
+    mutex_unlock(&state.mutex);
+}
+
+void workers_exit(void) {
+    if (!state.running) return;
+    mutex_lock(&state.mutex);
+    state.running = false;
+    condition_broadcast(&state.start);
+    mutex_unlock(&state.mutex);
+
+    for (uint32 i = 0; i < state.thread_count; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(state.threads[i], INFINITE);
+        CloseHandle(state.threads[i]);
+#else
+        pthread_join(state.threads[i], NULL);
+#endif
+    }
+    state.thread_count = 0;
+    condition_destroy(&state.start);
+    condition_destroy(&state.done);
+    mutex_destroy(&state.mutex);
+}
+
+static uint32 processor_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (uint32) count : 1;
+#endif
+}
+
+static void run_jobs(uint32 worker_index) {
+    for (;;) {
+        mutex_lock(&state.mutex);
+        if (state.next_job >= state.job_count) {
+            mutex_unlock(&state.mutex);
+            return;
+        }
+        uint64 job_index = state.next_job++;
+        mutex_unlock(&state.mutex);
+
+        state.job(state.data, worker_index, job_index);
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker_main(LPVOID arg) {
+#else
+static void *worker_main(void *arg) {
+#endif
+    uint32 worker_index = (uint32) (uintptr_t) arg;
+    uint64 generation = 0;
+
+    mutex_lock(&state.mutex);
+    for (;;) {
+        while (state.running && state.generation == generation) condition_wait(&state.start, &state.mutex);
+        if (!state.running) break;
+        generation = state.generation;
+        mutex_unlock(&state.mutex);
+
+        run_jobs(worker_index);
+
+        mutex_lock(&state.mutex);
+        if (--state.busy == 0) condition_broadcast(&state.done);
+    }
+    mutex_unlock(&state.mutex);
+    return 0;
+}
@@ -0,0 +1,17 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include "types.h"
+
+// upper limit for the threads taking part in a run, including the calling thread
+#define WORKERS_MAX 8
+
+// worker_index is 0 for the calling thread, every index runs one job at a time
+typedef void (*Worker_job)(void *data, uint32 worker_index, uint64 job_index);
+
+void workers_init(uint32 thread_count);
+uint32 workers_count(void);
+void workers_run(Worker_job job, void *data, uint64 job_count);
+void workers_exit(void);
+
+#endif // !WORKERS_H
@@ -13,6 +13,9 @@
 #include "engine/animation/animation.h"
 #include "engine/audio/audio.h"
 #include "engine/weapons.h"
+#include "engine/workers.h"
+#include "engine/arena.h"
+#include "engine/memory.h"
 
 static float32 PLAYER_SPEED = 350, PLAYER_JUMP_VELOCITY = 1200;
 static float32 SMALL_ENEMY_SPEED = 100, LARGE_ENEMY_SPEED = 150;
@@ -21,11 +24,19 @@ static float32 SMALL_ENEMY_HEALTH = 3, LARGE_ENEMY_HEALTH = 7;
 static int32 total_enemy_count = 3, current_enemy_spawn_counter = 0;
 static float32 spawn_timer = 0;
 static float32 width = 640, height = 360;
-
-static uint8 enemy_mask = COLLISION_LAYER_PLAYER | COLLISION_LAYER_TERRAIN;
-static uint8 player_mask = COLLISION_LAYER_ENEMY | COLLISION_LAYER_TERRAIN | COLLISION_LAYER_ENEMY_PASSTHROUGH;
-static uint8 fire_mask = COLLISION_LAYER_ENEMY | COLLISION_LAYER_PLAYER;
-static uint8 projectile_mask = COLLISION_LAYER_ENEMY | COLLISION_LAYER_TERRAIN;
+// physics runs at a fixed rate whatever the frame rate is
+static uint32 PHYSICS_STEP_RATE = 60, PHYSICS_MAX_STEPS = 5;
+// going over a budget only logs
+static uint64 PHYSICS_MEMORY_BUDGET = 64ull << 20, RENDER_MEMORY_BUDGET = 256ull << 20;
+static uint64 ANIMATION_MEMORY_BUDGET = 8ull << 20, ENTITIES_MEMORY_BUDGET = 8ull << 20;
+static uint64 SDL_MEMORY_BUDGET = 128ull << 20;
+// frames before this one fill the lists, pools and caches, later frames should not allocate
+static uint64 STEADY_STATE_FRAME = 300;
+
+static uint32 enemy_mask = COLLISION_LAYER_PLAYER | COLLISION_LAYER_TERRAIN;
+static uint32 player_mask = COLLISION_LAYER_ENEMY | COLLISION_LAYER_TERRAIN | COLLISION_LAYER_ENEMY_PASSTHROUGH;
+static uint32 fire_mask = COLLISION_LAYER_ENEMY | COLLISION_LAYER_PLAYER;
+static uint32 projectile_mask = COLLISION_LAYER_ENEMY | COLLISION_LAYER_TERRAIN;
 
 static SDL_Event event;
 static Mix_Music *MUSIC_STAGE_1;
@@ -72,7 +83,28 @@ void shoot_gun(void);
 uint64 spawn_player(void);
 void spawn_enemy(bool is_large, bool is_raged, bool is_flipped);
 
+static void *sdl_malloc(size_t size);
+static void *sdl_calloc(size_t count, size_t size);
+static void *sdl_realloc(void *ptr, size_t size);
+#ifdef _DEBUG_
+// steady state frames that made a heap allocation outside SDL, each of them is logged with the tags that allocated,
+// the frame arenas and the persistent lists should keep it at 0
+static uint64 frame_count = 0, allocating_frame_count = 0;
+static void allocation_counts_get(uint64 *counts);
+static void allocation_counts_check(uint64 *frame_counts);
+#endif
+
 int main(void) {
+    // SDL has to get its allocator before any other SDL call, SDL_mixer allocates through it as well
+    if (SDL_SetMemoryFunctions(sdl_malloc, sdl_calloc, sdl_realloc, memory_free)) {
+        ERROR_RETURN(1, "Unable to set SDL memory functions. SDL error: %s\n", SDL_GetError());
+    }
+    memory_budget_set(MEMORY_TAG_PHYSICS, PHYSICS_MEMORY_BUDGET);
+    memory_budget_set(MEMORY_TAG_RENDER, RENDER_MEMORY_BUDGET);
+    memory_budget_set(MEMORY_TAG_ANIMATION, ANIMATION_MEMORY_BUDGET);
+    memory_budget_set(MEMORY_TAG_ENTITIES, ENTITIES_MEMORY_BUDGET);
+    memory_budget_set(MEMORY_TAG_SDL, SDL_MEMORY_BUDGET);
+
     if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS)) {
         ERROR_RETURN(1, "Unable to initialize SDL. SDL error: %s\n", SDL_GetError());
     }
@@ -80,7 +112,12 @@ int main(void) {
     time_init(60);
     SDL_Window *window = render_init();
     config_init();
-    physics_init();
+    physics_init(&(Physics_config){.broadphase = PHYSICS_BROADPHASE_GRID, .solver = PHYSICS_SOLVER_SPECULATIVE});
+    physics_fixed_step_set(PHYSICS_STEP_RATE, PHYSICS_MAX_STEPS);
+    workers_init(0);
+    if (!frame_arena_init(FRAME_ARENA_SIZE, FRAME_ARENA_WORKER_SIZE)) {
+        ERROR_EXIT_PROGRAM("Exiting in frame arena init\n");
+    }
     entity_init();
     animation_init();
     audio_init();
@@ -101,6 +138,7 @@ int main(void) {
     physics_static_body_create((Body_data){.pos = {width * 0.5, 32 * 3 + 24}, .size = {448, 32}, .collision_layer = COLLISION_LAYER_TERRAIN});
     physics_static_body_create((Body_data){.pos = {16, height - 64}, .size = {32, 64}, .collision_layer = COLLISION_LAYER_ENEMY_PASSTHROUGH});
     physics_static_body_create((Body_data){.pos = {width - 16, height - 64}, .size = {32, 64}, .collision_layer = COLLISION_LAYER_ENEMY_PASSTHROUGH});
+    physics_static_bake();
 
     // Regular entities creation
     player_id = spawn_player();
@@ -152,6 +190,10 @@ int main(void) {
 
     while(app_running) {
         time_update();
+#ifdef _DEBUG_
+        uint64 frame_allocations[MEMORY_TAG_COUNT];
+        allocation_counts_get(frame_allocations);
+#endif
 
         if (player_died && timer_check_complete(player_spawn_timer)) {
             player_id = spawn_player();
@@ -161,7 +203,16 @@ int main(void) {
         player_body = (!player_died) ? physics_body_get(player->body_id) : NULL;
 
         handle_input();
-        physics_update();
+        uint32 physics_steps = physics_frame_begin(timing.delta);
+        for (uint32 i = 0; i < physics_steps; i++) {
+            // set again by the callbacks of the step while the player stands on ground or touches an enemy,
+            // frames without a step keep what the last step found
+            player_on_ground = false;
+            player_color[0] = 0;
+            player_color[2] = 1;
+            physics_update();
+            physics_events_dispatch();
+        }
         animation_update(timing.delta);
         render_begin();
 
@@ -171,44 +222,45 @@ int main(void) {
 
         // all sprites
         for (uint64 i = 0; i < entity_count(); i++) {
-            Entity *entity = entity_get(i);
+            Entity *entity = entity_at(i);
             if (!entity->active) continue;
             if (entity->animation_id == -1) continue;
             Body *body = physics_body_get(entity->body_id);
             Animation *anim = animation_get(entity->animation_id);
+            if (!anim) continue;
 
             if (body->velocity[0] < -1) anim->is_flipped = true;
             else if (body->velocity[0] > 1) anim->is_flipped = false;
+            physics_body_pixel_mask_set(entity->body_id, animation_pixel_mask(entity->animation_id), entity->sprite_offset, anim->is_flipped);
 
             //sprite center position
             vec2 pos;
-            vec2_add(pos, body->aabb.pos, entity->sprite_offset);
+            physics_body_interpolate(body, pos);
+            vec2_add(pos, pos, entity->sprite_offset);
             animation_render(entity->animation_id, pos, (vec2){-1, -1}, (vec4){1, 1, 1, 1});
         }
 
 #ifdef _DEBUG_
-        for (uint64 i = 0; i < entity_count(); i++) {
-            Entity *entity = entity_get(i);
-            // if (!entity->active) continue;
-            Body *body = physics_body_get(entity->body_id);
-            if (body->active) {
-                render_aabb(&body->aabb, (vec4){0.25, 0.25, 1, 1});
+        for (uint64 i = 0; i < physics_body_count(); i++) {
+            Body *body = physics_body_at(i);
+            AABB aabb = physics_body_aabb(body);
+            if (physics_body_is_active(body)) {
+                render_aabb(&aabb, (vec4){0.25, 0.25, 1, 1});
             }
             else {
-                render_aabb(&body->aabb, (vec4){1, 0, 0, 1});
+                render_aabb(&aabb, (vec4){1, 0, 0, 1});
             }
         }
 
         for (int i = 0; i < physics_static_body_count(); i++) {
             Static_body *body = physics_static_body_get(i);
+            if (!body->active) continue;
             render_aabb(&body->aabb, (vec4){1, 1, 1, 1});
         }
 #endif
 
         render_end(window, &width, &height);
         time_update_end();
-        player_color[0] = 0;
-        player_color[2] = 1;
 
         spawn_timer -= timing.delta;
         if (spawn_timer <= 0) {
@@ -225,32 +277,85 @@ int main(void) {
         projectile_timer -= (projectile_timer <= 0) ? 0 : timing.delta;
 
         // show fps
-        char FPS[10];
-        int printed = snprintf(FPS, 10, "FPS: %d", timing.frame_rate);
-        if (printed > 9)
-            SDL_SetWindowTitle(window, "frame_rate_truncated");
-        else
-            SDL_SetWindowTitle(window, FPS);
+        char *fps = frame_alloc(32);
+        if (fps) {
+            snprintf(fps, 32, "FPS: %u", timing.frame_rate);
+            SDL_SetWindowTitle(window, fps);
+        }
+#ifdef _DEBUG_
+        allocation_counts_check(frame_allocations);
+        frame_count++;
+#endif
     }
     // Exiting program
     time_exit();
     render_exit();
+    workers_exit();
+#ifdef _DEBUG_
+    uint64 frame_arena_used[WORKERS_MAX];
+    for (uint32 w = 0; w < WORKERS_MAX; w++)
+        frame_arena_used[w] = frame_arena_high_water(w);
+#endif
+    frame_arena_exit();
     physics_exit();
     entity_exit();
     animation_exit();
-    glDeleteTextures(1, &player_sprites.texture_id);
-    glDeleteTextures(1, &map_sprites.texture_id);
-    glDeleteTextures(1, &enemy_large_sprites.texture_id);
-    glDeleteTextures(1, &enemy_small_sprites.texture_id);
-    glDeleteTextures(1, &props_sprites.texture_id);
+    render_free_sprite_sheet(&player_sprites);
+    render_free_sprite_sheet(&map_sprites);
+    render_free_sprite_sheet(&enemy_large_sprites);
+    render_free_sprite_sheet(&enemy_small_sprites);
+    render_free_sprite_sheet(&props_sprites);
+    render_free_sprite_sheet(&fire_sprites);
     Mix_FreeChunk(JUMP_SOUND);
     Mix_FreeMusic(MUSIC_STAGE_1);
 
     SDL_DestroyWindow(window);
     SDL_Quit();
+#ifdef _DEBUG_
+    memory_report();
+    printf("%" PRIu64 " of %" PRIu64 " steady state frames allocated, frame arena high water %" PRIu64 " bytes\n",
+           allocating_frame_count, (frame_count > STEADY_STATE_FRAME) ? frame_count - STEADY_STATE_FRAME : 0,
+           frame_arena_used[0]);
+    for (uint32 w = 1; w < WORKERS_MAX; w++)
+        if (frame_arena_used[w] > 0) printf("worker %u frame arena high water %" PRIu64 " bytes\n", w, frame_arena_used[w]);
+#endif
     return 0;
 }
 
+#ifdef _DEBUG_
+static void allocation_counts_get(uint64 *counts) {
+    for (uint32 tag = 0; tag < MEMORY_TAG_COUNT; tag++)
+        counts[tag] = memory_stats_get(tag).allocation_count;
+}
+
+// SDL is left out, its drivers allocate on their own every frame
+static void allocation_counts_check(uint64 *frame_counts) {
+    if (frame_count < STEADY_STATE_FRAME) return;
+    uint64 counts[MEMORY_TAG_COUNT];
+    allocation_counts_get(counts);
+    bool allocated = false;
+    for (uint32 tag = 0; tag < MEMORY_TAG_COUNT; tag++) {
+        if (tag == MEMORY_TAG_SDL || counts[tag] == frame_counts[tag]) continue;
+        fprintf(stderr, "Frame %" PRIu64 " made %" PRIu64 " %s allocations in steady state\n",
+                frame_count, counts[tag] - frame_counts[tag], memory_tag_name(tag));
+        allocated = true;
+    }
+    if (allocated) allocating_frame_count++;
+}
+#endif
+
+static void *sdl_malloc(size_t size) {
+    return memory_alloc(MEMORY_TAG_SDL, size);
+}
+
+static void *sdl_calloc(size_t count, size_t size) {
+    return memory_calloc(MEMORY_TAG_SDL, count, size);
+}
+
+static void *sdl_realloc(void *ptr, size_t size) {
+    return memory_realloc(MEMORY_TAG_SDL, ptr, size);
+}
+
 static void handle_input(void) {
     while (SDL_PollEvent(&event)) {
         if (event.type == SDL_QUIT) app_running = false;
@@ -284,6 +389,8 @@ static void handle_input(void) {
         if (keys[KEY_UP] != KEY_UNPRESSED && player_on_ground) {
             vely = PLAYER_JUMP_VELOCITY;
             audio_play_sound(JUMP_SOUND);
+            // one jump until a step finds the player on ground again
+            player_on_ground = false;
         }
         if (keys[KEY_SHOOT] != KEY_UNPRESSED) {
             if (projectile_timer <= 0) {
@@ -295,13 +402,14 @@ static void handle_input(void) {
 
         player_body->velocity[0] = velx;
         player_body->velocity[1] = vely;
-        player_on_ground = false;
     }
 }
 
 // Entity callbacks
 void player_on_hit_callback(Body *self, Body *other, Collision *collision) {
-    if (other->collision_layer == COLLISION_LAYER_ENEMY) {
+    // the player reports stay events so the color holds while an enemy is touching
+    if (collision->kind == COLLISION_EVENT_EXIT) return;
+    if (physics_body_layer(other) == COLLISION_LAYER_ENEMY) {
         player_color[0] = 1;
         player_color[2] = 0;
     }
@@ -342,15 +450,18 @@ void large_enemy_on_static_hit_callback(Body *self, Static_body *other, Collisio
 }
 
 void fire_on_hit(Body *self, Body *other, Collision *collision) {
-    if (other->collision_layer == COLLISION_LAYER_PLAYER) {
+    if (collision->kind == COLLISION_EVENT_EXIT) return;
+    if (physics_body_layer(other) == COLLISION_LAYER_PLAYER) {
         ASSERT_RETURN(other->entity_id != -1, (void) 0, "Illegal player entity_id  in body struct\n");
         player_died = true;
         entity_destroy(player_id);
         timer_restart(player_spawn_timer);
     }
-    if (other->collision_layer == COLLISION_LAYER_ENEMY) {
+    if (physics_body_layer(other) == COLLISION_LAYER_ENEMY) {
         ASSERT_RETURN(other->entity_id != -1, (void) 0, "Illegal enemy entity_id  in body struct\n");
         Entity *entity = entity_get(other->entity_id);
+        // already killed by another hit of this dispatch
+        if (!entity) return;
         Entity_type entity_type = entity->type;
         ASSERT_RETURN(entity->animation_id != -1, (void) 0, "Illegal Animation id in entity struct\n");
         animation_destroy(entity->animation_id);
@@ -368,10 +479,12 @@ void projectile_on_static_hit_callback(Body *self, Static_body *other, Collision
     }
 }
 void projectile_on_hit_callback(Body *self, Body *other, Collision *collision) {
-    if (other->collision_layer == COLLISION_LAYER_ENEMY) {
+    if (collision->kind == COLLISION_EVENT_EXIT) return;
+    if (physics_body_layer(other) == COLLISION_LAYER_ENEMY) {
         uint64 projectile_id = self->entity_id;
         entity_destroy(projectile_id);
         Entity *enemy = entity_get(other->entity_id);
+        if (!enemy) return;
         animation_destroy(enemy->animation_id);
         entity_destroy(other->entity_id);
     }
@@ -432,7 +545,8 @@ void spawn_enemy(bool is_large, bool is_raged, bool is_flipped) {
 uint64 spawn_player(void) {
     Body_data body_data = {
         .pos = {300, 150}, .size = {25, 25},
-        .velocity = {0, 0}, .collision_layer = COLLISION_LAYER_PLAYER, .collision_mask = player_mask};
+        .velocity = {0, 0}, .collision_layer = COLLISION_LAYER_PLAYER, .collision_mask = player_mask,
+        .contact_stay = true, .never_sleep = true};
 
     uint64 spawned_player_id = entity_create(&body_data, ENTITY_PLAYER, (vec4){0, 0},
                                      player_on_hit_callback, player_on_static_hit_callback, NULL);
@@ -451,7 +565,7 @@ void shoot_gun(void) {
         projectile_anim_id = rocket_projectile_anim_id;
     }
     uint64 projectile_id = entity_create(&(Body_data){
-        .pos = {player_body->aabb.pos[0], player_body->aabb.pos[1]}, .velocity = {velocity, 0},
+        .pos = {player_body->pos[0], player_body->pos[1]}, .velocity = {velocity, 0},
         .size = {16, 16}, .kinematic = true, .collision_mask = projectile_mask, .collision_layer = COLLISION_LAYER_PROJECTILE,
     }, ENTITY_PROJECTILE, (vec2){0, 0}, projectile_on_hit_callback, projectile_on_static_hit_callback, NULL);
 
@@ -0,0 +1,209 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../engine/types.h"
+#include "../engine/utils.h"
+#include "../engine/physics/physics.h"
+#include "../engine/physics/body_store.h"
+#include "../engine/physics/physics_fixed.h"
+#include "../engine/workers.h"
+#include "test_util.h"
+
+// the fixed point physics against the float one and against itself on other builds
+// usage: physics_fixed_test [--write FILE] [--compare FILE] [--golden FILE]
+// both builds first check that the SIMD pairs of the fixed velocity kernel give the same bits as its scalar tail,
+// then step the same world and --write saves the trajectory, --compare fails when the positions of this run
+// are more than TRAJECTORY_TOLERANCE away from the saved ones and --golden fails when they differ in any bit,
+// ctest writes with the float build and compares with the fixed point build, and every fixed point build,
+// optimized or not, has to give the bytes of src/test/data/physics_fixed_trajectory.bin, which is written
+// with --write by the fixed point build when the world or the fixed point math changes on purpose
+
+#define KERNEL_BODIES 4099
+#define WORLD_BODIES 64
+#define WORLD_TICKS 180
+// 64 steps per second so the step and the gravity of a step are exact in Q16.16 as well
+#define WORLD_STEP_RATE 64
+// units a position may drift between the builds, rounding alone stays near 0.1 but a wall hit can
+// come one step apart, which moves the body by one step of the fastest speed below
+#define TRAJECTORY_TOLERANCE 2.0f
+
+static bool kernel_check(void);
+static bool trajectory_record(vec2 *trajectory);
+static bool trajectory_read(const char *path, vec2 *trajectory, uint64 point_count);
+static void on_static_hit(Body *self, Static_body *other, Collision *hit);
+static float32 random_velocity(void);
+
+int main(int argc, char **argv) {
+    const char *write_path = NULL, *compare_path = NULL, *golden_path = NULL;
+    Test_option options[] = {
+        {.name = "--write", .text = &write_path},
+        {.name = "--compare", .text = &compare_path},
+        {.name = "--golden", .text = &golden_path}
+    };
+    if (!test_options_parse(argc, argv, options, 3)) {
+        ERROR_RETURN(1, "usage: physics_fixed_test [--write FILE] [--compare FILE] [--golden FILE]\n");
+    }
+    if (!kernel_check()) return 1;
+
+    uint64 point_count = (uint64) WORLD_BODIES * WORLD_TICKS;
+    vec2 *trajectory = malloc(point_count * sizeof(vec2));
+    vec2 *expected = malloc(point_count * sizeof(vec2));
+    if (!trajectory || !expected) {
+        ERROR_RETURN(1, "Unable to allocate memory for trajectories\n");
+    }
+    if (!trajectory_record(trajectory)) return 1;
+
+    if (write_path) {
+        FILE *file = fopen(write_path, "wb");
+        if (!file || fwrite(trajectory, sizeof(vec2), point_count, file) != point_count) {
+            ERROR_RETURN(1, "Unable to write trajectory to %s\n", write_path);
+        }
+        fclose(file);
+    }
+    if (golden_path) {
+        if (!trajectory_read(golden_path, expected, point_count)) return 1;
+        for (uint64 p = 0; p < point_count; p++) {
+            if (memcmp(trajectory[p], expected[p], sizeof(vec2)) != 0) {
+                ERROR_RETURN(1, "Body %" PRIu64 " at tick %" PRIu64 " is at (%a, %a) instead of (%a, %a)\n",
+                             p % WORLD_BODIES, p / WORLD_BODIES, trajectory[p][0], trajectory[p][1],
+                             expected[p][0], expected[p][1]);
+            }
+        }
+        printf("physics_fixed_test: trajectory matches %s bit for bit\n", golden_path);
+    }
+    if (compare_path) {
+        if (!trajectory_read(compare_path, expected, point_count)) return 1;
+        float32 max_drift = 0;
+        for (uint64 p = 0; p < point_count; p++) {
+            for (uint8 i = 0; i < 2; i++) {
+                float32 drift = fabsf(trajectory[p][i] - expected[p][i]);
+                if (!(drift <= TRAJECTORY_TOLERANCE)) {
+                    ERROR_RETURN(1, "Body %" PRIu64 " at tick %" PRIu64 " is %g units away from the saved trajectory\n",
+                                 p % WORLD_BODIES, p / WORLD_BODIES, drift);
+                }
+                if (drift > max_drift) max_drift = drift;
+            }
+        }
+        printf("physics_fixed_test: trajectories within %g units, largest drift %g\n", TRAJECTORY_TOLERANCE, max_drift);
+    }
+    free(trajectory);
+    free(expected);
+    return 0;
+}
+
+// integrates the same bodies once in a single call and once one body per call, which only runs the scalar tail
+static bool kernel_check(void) {
+    Body_store pairs, tails;
+    body_store_init(&pairs);
+    body_store_init(&tails);
+    if (!body_store_reserve(&pairs, KERNEL_BODIES) || !body_store_reserve(&tails, KERNEL_BODIES)) {
+        ERROR_RETURN(false, "Unable to allocate memory for the kernel check\n");
+    }
+    pairs.len = tails.len = KERNEL_BODIES;
+
+    uint32 ids[KERNEL_BODIES];
+    for (uint32 i = 0; i < KERNEL_BODIES; i++) {
+        ids[i] = i;
+        pairs.velocity[i][0] = random_velocity();
+        pairs.velocity[i][1] = random_velocity();
+        pairs.acceleration[i][0] = random_velocity();
+        pairs.acceleration[i][1] = random_velocity();
+    }
+    // the kernel gathers bodies from anywhere in the store
+    for (uint32 i = KERNEL_BODIES - 1; i > 0; i--) {
+        uint32 j = test_random_next() % (i + 1), id = ids[i];
+        ids[i] = ids[j];
+        ids[j] = id;
+    }
+    memcpy(tails.velocity, pairs.velocity, KERNEL_BODIES * sizeof(vec2));
+    memcpy(tails.acceleration, pairs.acceleration, KERNEL_BODIES * sizeof(vec2));
+
+    uint32 half = KERNEL_BODIES / 2;
+    fixed_integrate(&pairs, ids, half, -4500, -7000, 1.0f / 60);
+    fixed_accelerate(&pairs, &ids[half], KERNEL_BODIES - half, 1.0f / 60);
+    for (uint32 i = 0; i < half; i++)
+        fixed_integrate(&tails, &ids[i], 1, -4500, -7000, 1.0f / 60);
+    for (uint32 i = half; i < KERNEL_BODIES; i++)
+        fixed_accelerate(&tails, &ids[i], 1, 1.0f / 60);
+
+    bool match = memcmp(pairs.velocity, tails.velocity, KERNEL_BODIES * sizeof(vec2)) == 0;
+    body_store_free(&pairs);
+    body_store_free(&tails);
+    if (!match) {
+        ERROR_RETURN(false, "The SIMD and scalar fixed point velocity kernels disagree\n");
+    }
+    printf("physics_fixed_test: velocity kernel pairs and tail match for %u bodies\n", KERNEL_BODIES);
+    return true;
+}
+
+// falling and sliding bodies between a floor and two walls, positions after every tick
+static bool trajectory_record(vec2 *trajectory) {
+    physics_init(NULL);
+    physics_fixed_step_set(WORLD_STEP_RATE, 1);
+    workers_init(1);
+
+    physics_static_body_create((Body_data){.pos = {320, 8}, .size = {640, 16}, .collision_layer = COLLISION_LAYER_TERRAIN});
+    physics_static_body_create((Body_data){.pos = {8, 180}, .size = {16, 360}, .collision_layer = COLLISION_LAYER_TERRAIN});
+    physics_static_body_create((Body_data){.pos = {632, 180}, .size = {16, 360}, .collision_layer = COLLISION_LAYER_TERRAIN});
+    physics_static_body_create((Body_data){.pos = {320, 30}, .size = {128, 16}, .collision_layer = COLLISION_LAYER_TERRAIN});
+    physics_static_bake();
+
+    // spread apart so only the terrain is hit and the paths stay smooth
+    for (uint32 b = 0; b < WORLD_BODIES; b++) {
+        uint64 handle = physics_body_create(&(Body_data){
+            .pos = {40 + (b % 16) * 36.0f, 60 + (b / 16) * 70.0f}, .size = {12, 12},
+            .velocity = {(float32) ((int32) (b % 7) * 40 - 120), (float32) (b % 5) * 60},
+            .collision_layer = COLLISION_LAYER_ENEMY, .collision_mask = COLLISION_LAYER_TERRAIN,
+            .kinematic = b % 8 == 7
+        }, NULL, on_static_hit);
+        if (handle == -1) {
+            ERROR_RETURN(false, "Unable to create test body\n");
+        }
+        if (b % 8 == 7) physics_body_get(handle)->acceleration[1] = -50;
+    }
+
+    for (uint32 t = 0; t < WORLD_TICKS; t++) {
+        physics_frame_begin(1.0f / WORLD_STEP_RATE);
+        physics_update();
+        physics_events_dispatch();
+        for (uint32 b = 0; b < WORLD_BODIES; b++) {
+            Body *body = physics_body_at(b);
+            trajectory[t * WORLD_BODIES + b][0] = body->pos[0];
+            trajectory[t * WORLD_BODIES + b][1] = body->pos[1];
+        }
+    }
+    workers_exit();
+    physics_exit();
+    return true;
+}
+
+// the file has to hold exactly point_count positions
+static bool trajectory_read(const char *path, vec2 *trajectory, uint64 point_count) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        ERROR_RETURN(false, "Unable to open trajectory %s\n", path);
+    }
+    bool complete = fread(trajectory, sizeof(vec2), point_count, file) == point_count && fgetc(file) == EOF;
+    fclose(file);
+    if (!complete) {
+        ERROR_RETURN(false, "Trajectory %s does not hold %" PRIu64 " positions\n", path, point_count);
+    }
+    return true;
+}
+
+static void on_static_hit(Body *self, Static_body *other, Collision *hit) {
+    if (hit->normal[0] != 0) self->velocity[0] = -self->velocity[0];
+    if (hit->normal[1] != 0) self->velocity[1] = 0;
+}
+
+// mostly ordinary speeds, some values the conversions saturate and some negative ones below -1
+// where the SIMD product needs its sign correction
+static float32 random_velocity(void) {
+    uint32 kind = test_random_next() % 8;
+    float32 unit = (float32) (test_random_next() >> 8) / (float32) (1 << 24);
+    if (kind == 0) return (unit - 0.5f) * 80000;
+    if (kind == 1) return -unit * 3;
+    return (unit - 0.5f) * 2000;
+}
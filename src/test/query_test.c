@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../engine/types.h"
+#include "../engine/utils.h"
+#include "../engine/arena.h"
+#include "../engine/physics/physics.h"
+#include "../engine/workers.h"
+#include "test_util.h"
+
+// the box, point and ray queries over bodies and static bodies
+// usage: query_test [--queries N] [--seed S], exits with 1 on the first failed check
+// bodies of random layers fall for a few steps with some destroyed in between, then every query has to find
+// the same bodies and static bodies as a test of each of them, only the ones on a layer of the collision mask,
+// and physics_raycast_all has to give the nearest hits in the order of their times with bodies before
+// static bodies at the same time, also when it keeps fewer hits than the ray crosses
+// the steps and queries take their scratch lists from frame arenas like in the game
+
+#define BODY_COUNT 300
+#define STATIC_COUNT 80
+#define STEP_COUNT 8
+#define HITS_MAX 512
+
+static Physics_query_hit hits[HITS_MAX], expected[HITS_MAX];
+static bool found[2][BODY_COUNT];
+
+static bool world_create(void);
+static bool overlap_check(uint32 query, bool point);
+static bool raycast_check(uint32 query);
+static uint64 raycast_reference(vec2 origin, vec2 magnitude, uint32 mask);
+static bool reference_ray_hit(Physics_query_hit *hit, vec2 origin, vec2 magnitude, AABB aabb);
+static uint32 random_layer(void);
+static float32 random_coordinate(void);
+
+int main(int argc, char **argv) {
+    uint64 query_count = 2000, seed = 1;
+    Test_option options[] = {{.name = "--queries", .number = &query_count}, {.name = "--seed", .number = &seed}};
+    if (!test_options_parse(argc, argv, options, 2)) {
+        ERROR_RETURN(1, "usage: query_test [--queries N] [--seed S]\n");
+    }
+    test_random_seed((uint32) seed);
+
+    physics_init(NULL);
+    workers_init(2);
+    if (!frame_arena_init(FRAME_ARENA_SIZE, FRAME_ARENA_WORKER_SIZE)) return 1;
+    if (!world_create()) return 1;
+
+    for (uint32 q = 0; q < query_count; q++) {
+        bool passed = (q % 3 == 0) ? overlap_check(q, false) : (q % 3 == 1) ? overlap_check(q, true) : raycast_check(q);
+        if (!passed) return 1;
+    }
+    printf("query_test: %" PRIu64 " queries over %" PRIu64 " body slots and %" PRIu64 " static bodies, all match\n",
+           query_count, physics_body_count(), physics_static_body_count());
+
+    workers_exit();
+    frame_arena_exit();
+    physics_exit();
+    return 0;
+}
+
+// bodies overlapping each other and the static bodies, stepped so the query tree has to follow them
+static bool world_create(void) {
+    for (uint32 i = 0; i < STATIC_COUNT; i++) {
+        physics_static_body_create((Body_data){
+            .pos = {random_coordinate(), random_coordinate()},
+            .size = {(float32) (4 + test_random_next() % 60), (float32) (4 + test_random_next() % 60)},
+            .collision_layer = random_layer()
+        });
+    }
+    physics_static_bake();
+
+    uint64 handles[BODY_COUNT];
+    for (uint32 i = 0; i < BODY_COUNT; i++) {
+        handles[i] = physics_body_create(&(Body_data){
+            .pos = {random_coordinate(), random_coordinate()},
+            .size = {(float32) (2 + test_random_next() % 30), (float32) (2 + test_random_next() % 30)},
+            .velocity = {(float32) ((int32) (test_random_next() % 401) - 200), 0},
+            .collision_layer = random_layer(),
+            .kinematic = i % 4 == 0
+        }, NULL, NULL);
+        if (handles[i] == -1) {
+            ERROR_RETURN(false, "Unable to create test body\n");
+        }
+    }
+
+    physics_fixed_step_set(60, 1);
+    for (uint32 s = 0; s < STEP_COUNT; s++) {
+        frame_arena_begin();
+        physics_frame_begin(1.0f / 60);
+        physics_update();
+        physics_events_dispatch();
+        // the slots of destroyed bodies stay behind in the store
+        physics_body_destroy(handles[test_random_next() % BODY_COUNT]);
+    }
+    return true;
+}
+
+// box or point query against a test of every active body and static body
+static bool overlap_check(uint32 query, bool point) {
+    vec2 pos = {random_coordinate(), random_coordinate()};
+    AABB box = {.pos = {pos[0], pos[1]}, .half_size = {(float32) (test_random_next() % 80), (float32) (test_random_next() % 80)}};
+    uint32 mask = (query % 5 == 0) ? UINT32_MAX : random_layer() | random_layer();
+
+    uint64 count = point ? physics_query_point(pos, mask, hits, HITS_MAX) : physics_query_aabb(&box, mask, hits, HITS_MAX);
+    if (count == HITS_MAX) {
+        ERROR_RETURN(false, "Query %u found more hits than the check has room for\n", query);
+    }
+    memset(found, 0, sizeof(found));
+    for (uint64 h = 0; h < count; h++) {
+        uint64 limit = hits[h].is_static ? physics_static_body_count() : physics_body_count();
+        if (hits[h].id >= limit || found[hits[h].is_static][hits[h].id]) {
+            ERROR_RETURN(false, "Query %u found body %u twice or one which does not exist\n", query, hits[h].id);
+        }
+        found[hits[h].is_static][hits[h].id] = true;
+        // bodies first, both in ascending id order
+        if (h > 0 && (hits[h - 1].is_static > hits[h].is_static ||
+                      (hits[h - 1].is_static == hits[h].is_static && hits[h - 1].id > hits[h].id))) {
+            ERROR_RETURN(false, "Query %u gave its hits out of order at %" PRIu64 "\n", query, h);
+        }
+    }
+
+    for (uint64 i = 0; i < physics_body_count(); i++) {
+        Body *body = physics_body_at(i);
+        AABB aabb = physics_body_aabb(body);
+        bool expected_hit = physics_body_is_active(body) && (physics_body_layer(body) & mask) &&
+                            (point ? physics_point_intersect(pos, &aabb) : physics_aabb_intersect(&box, &aabb));
+        if (expected_hit != found[0][i]) {
+            ERROR_RETURN(false, "%s query %u %s body %" PRIu64 "\n", point ? "Point" : "Box", query,
+                         expected_hit ? "missed" : "found the destroyed, filtered or distant", i);
+        }
+    }
+    for (uint64 i = 0; i < physics_static_body_count(); i++) {
+        Static_body *static_body = physics_static_body_get(i);
+        bool expected_hit = static_body->active && (static_body->collision_layer & mask) &&
+                            (point ? physics_point_intersect(pos, &static_body->aabb)
+                                   : physics_aabb_intersect(&box, &static_body->aabb));
+        if (expected_hit != found[1][i]) {
+            ERROR_RETURN(false, "%s query %u %s static body %" PRIu64 "\n", point ? "Point" : "Box", query,
+                         expected_hit ? "missed" : "found the filtered or distant", i);
+        }
+    }
+    return true;
+}
+
+// every hit of the reference in the same order, a few times with room for only some of them
+static bool raycast_check(uint32 query) {
+    vec2 origin = {random_coordinate(), random_coordinate()};
+    vec2 magnitude = {(float32) ((int32) (test_random_next() % 801) - 400), (float32) ((int32) (test_random_next() % 801) - 400)};
+    if (test_random_next() % 4 == 0) magnitude[test_random_next() % 2] = 0;
+    uint32 mask = (query % 5 == 0) ? UINT32_MAX : random_layer() | random_layer();
+
+    uint64 expected_count = raycast_reference(origin, magnitude, mask);
+    uint64 max_hits = (query % 4 == 0 && expected_count > 1) ? 1 + test_random_next() % (expected_count - 1) : HITS_MAX;
+    uint64 count = physics_raycast_all(origin, magnitude, mask, hits, max_hits);
+    if (count != ((expected_count < max_hits) ? expected_count : max_hits)) {
+        ERROR_RETURN(false, "Raycast %u found %" PRIu64 " hits with room for %" PRIu64 ", the reference %" PRIu64 "\n",
+                     query, count, max_hits, expected_count);
+    }
+
+    // boxes at the same time may come in any order among themselves, so each hit is compared
+    // with the reference hit of its box and the ids are checked as a set over every run of equal times
+    // the reference kept in full
+    memset(found, 0, sizeof(found));
+    for (uint64 h = 0; h < count; h++) {
+        Physics_query_hit *reference = NULL;
+        for (uint64 e = 0; e < expected_count && !reference; e++)
+            if (expected[e].id == hits[h].id && expected[e].is_static == hits[h].is_static) reference = &expected[e];
+        if (!reference || found[hits[h].is_static][hits[h].id] ||
+            hits[h].time != expected[h].time || hits[h].is_static != expected[h].is_static ||
+            memcmp(hits[h].pos, reference->pos, sizeof(vec2)) != 0 ||
+            memcmp(hits[h].normal, reference->normal, sizeof(vec2)) != 0) {
+            ERROR_RETURN(false, "Raycast %u hit %" PRIu64 " is %s %u at %g, the reference %s %u at %g\n", query, h,
+                         hits[h].is_static ? "static body" : "body", hits[h].id, hits[h].time,
+                         expected[h].is_static ? "static body" : "body", expected[h].id, expected[h].time);
+        }
+        found[hits[h].is_static][hits[h].id] = true;
+    }
+    for (uint64 h = 0; h < count; h++) {
+        bool kept_in_full = count == expected_count || expected[count - 1].time != expected[h].time;
+        if (kept_in_full && !found[expected[h].is_static][expected[h].id]) {
+            ERROR_RETURN(false, "Raycast %u missed %s %u at %g\n", query,
+                         expected[h].is_static ? "static body" : "body", expected[h].id, expected[h].time);
+        }
+    }
+    return true;
+}
+
+// every box on the ray sorted by time, bodies before static bodies at the same time
+static uint64 raycast_reference(vec2 origin, vec2 magnitude, uint32 mask) {
+    uint64 count = 0;
+    for (uint64 i = 0; i < physics_body_count() + physics_static_body_count(); i++) {
+        bool is_static = i >= physics_body_count();
+        uint32 id = (uint32) (is_static ? i - physics_body_count() : i);
+        AABB aabb;
+        if (is_static) {
+            Static_body *static_body = physics_static_body_get(id);
+            if (!static_body->active || !(static_body->collision_layer & mask)) continue;
+            aabb = static_body->aabb;
+        }
+        else {
+            Body *body = physics_body_at(id);
+            if (!physics_body_is_active(body) || !(physics_body_layer(body) & mask)) continue;
+            aabb = physics_body_aabb(body);
+        }
+        Physics_query_hit hit = {.id = id, .is_static = is_static};
+        if (!reference_ray_hit(&hit, origin, magnitude, aabb)) continue;
+        if (count == HITS_MAX) {
+            ERROR_EXIT_PROGRAM("A ray crossed more boxes than the check has room for\n");
+        }
+        uint64 h = count++;
+        for (; h > 0 && (expected[h - 1].time > hit.time ||
+                         (expected[h - 1].time == hit.time && expected[h - 1].is_static && !is_static)); h--)
+            expected[h] = expected[h - 1];
+        expected[h] = hit;
+    }
+    return count;
+}
+
+// a ray starting inside a box hits it at time 0 at its origin with a zero normal
+static bool reference_ray_hit(Physics_query_hit *hit, vec2 origin, vec2 magnitude, AABB aabb) {
+    Collision collision = ray_collide_aabb(origin, magnitude, aabb);
+    if (!collision.collided) return false;
+    bool inside = collision.time < 0;
+    hit->time = inside ? 0 : collision.time;
+    hit->pos[0] = inside ? origin[0] : collision.pos[0];
+    hit->pos[1] = inside ? origin[1] : collision.pos[1];
+    hit->normal[0] = inside ? 0 : collision.normal[0];
+    hit->normal[1] = inside ? 0 : collision.normal[1];
+    return true;
+}
+
+// one of the game layers, the filter is tested with masks of one or two of them
+static uint32 random_layer(void) {
+    return 1u << (test_random_next() % 5);
+}
+
+// whole and half units so boxes often share an edge with a query or a ray
+static float32 random_coordinate(void) {
+    return (float32) (test_random_next() % 1024) * 0.5f;
+}
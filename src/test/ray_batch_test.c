@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../engine/types.h"
+#include "../engine/utils.h"
+#include "../engine/physics/physics.h"
+#include "../engine/physics/ray_batch.h"
+#include "test_util.h"
+
+// checks ray_collide_aabb_batch against ray_collide_aabb for random rays and boxes,
+// every lane has to give the same hit flag, time, position and normal, bit for bit except
+// for the sign of a zero time which fmaxf leaves open
+// usage: ray_batch_test [--rays N] [--seed S], exits with 1 on the first mismatch
+// the ray_batch_test_scalar target runs the same checks on the scalar kernel
+
+static float32 random_coordinate(void);
+static void random_ray(vec2 pos, vec2 magnitude, AABB *boxes, uint32 count);
+static bool collisions_match(Collision *a, Collision *b);
+
+int main(int argc, char **argv) {
+    uint64 ray_count = 200000, seed = 1;
+    Test_option options[] = {{.name = "--rays", .number = &ray_count}, {.name = "--seed", .number = &seed}};
+    if (!test_options_parse(argc, argv, options, 2)) {
+        ERROR_RETURN(1, "usage: ray_batch_test [--rays N] [--seed S]\n");
+    }
+    test_random_seed((uint32) seed);
+
+    uint64 hit_count = 0, lane_count = 0;
+    for (uint64 r = 0; r < ray_count; r++) {
+        // every batch size so the tails of 1 to 3 lanes are covered as much as full batches
+        uint32 count = 1 + r % RAY_BATCH_WIDTH;
+        AABB boxes[RAY_BATCH_WIDTH];
+        vec2 pos, magnitude;
+        for (uint32 lane = 0; lane < count; lane++) {
+            boxes[lane] = (AABB){
+                .pos = {random_coordinate(), random_coordinate()},
+                .half_size = {(float32) (test_random_next() % 16), (float32) (test_random_next() % 16)}
+            };
+        }
+        random_ray(pos, magnitude, boxes, count);
+
+        Ray_batch batch = {0};
+        for (uint32 lane = 0; lane < count; lane++)
+            ray_batch_add(&batch, &boxes[lane]);
+        Collision hits[RAY_BATCH_WIDTH];
+        uint32 mask = ray_collide_aabb_batch(pos, magnitude, &batch, hits);
+
+        for (uint32 lane = 0; lane < count; lane++) {
+            Collision expected = ray_collide_aabb(pos, magnitude, boxes[lane]);
+            Collision actual = (mask & (1u << lane)) ? hits[lane] : (Collision){0};
+            if (!collisions_match(&expected, &actual)) {
+                ERROR_RETURN(1, "Mismatch for ray %" PRIu64 " lane %u: pos (%g, %g) magnitude (%g, %g) "
+                             "box (%g, %g) half (%g, %g), expected %d at %g, got %d at %g\n",
+                             r, lane, pos[0], pos[1], magnitude[0], magnitude[1],
+                             boxes[lane].pos[0], boxes[lane].pos[1], boxes[lane].half_size[0], boxes[lane].half_size[1],
+                             expected.collided, expected.time, actual.collided, actual.time);
+            }
+            hit_count += expected.collided;
+        }
+        lane_count += count;
+    }
+    printf("ray_batch_test: %" PRIu64 " lanes, %" PRIu64 " hits, all match\n", lane_count, hit_count);
+    return 0;
+}
+
+// whole and half units so rays often start on a box edge or run along it
+static float32 random_coordinate(void) {
+    return (float32) (test_random_next() % 128) * 0.5f - 32;
+}
+
+// a quarter of the rays start inside a box and a quarter graze its edge along a zero axis,
+// the others start anywhere, a zero magnitude on either axis in about a third of all rays
+static void random_ray(vec2 pos, vec2 magnitude, AABB *boxes, uint32 count) {
+    AABB *box = &boxes[test_random_next() % count];
+    uint32 start = test_random_next() % 4;
+    pos[0] = random_coordinate();
+    pos[1] = random_coordinate();
+    magnitude[0] = (float32) ((int32) (test_random_next() % 129) - 64);
+    magnitude[1] = (float32) ((int32) (test_random_next() % 129) - 64);
+    if (test_random_next() % 3 == 0) magnitude[test_random_next() % 2] = 0;
+
+    if (start == 0) {
+        pos[0] = box->pos[0];
+        pos[1] = box->pos[1];
+    }
+    else if (start == 1) {
+        uint32 axis = test_random_next() % 2;
+        float32 side = (test_random_next() % 2) ? 1 : -1;
+        pos[axis] = box->pos[axis] + side * box->half_size[axis];
+        magnitude[axis] = 0;
+    }
+}
+
+static bool collisions_match(Collision *a, Collision *b) {
+    if (a->collided != b->collided) return false;
+    if (!a->collided) return true;
+    return a->time == b->time &&
+           memcmp(a->pos, b->pos, sizeof(vec2)) == 0 &&
+           memcmp(a->normal, b->normal, sizeof(vec2)) == 0;
+}
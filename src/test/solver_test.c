@@ -0,0 +1,198 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../engine/types.h"
+#include "../engine/utils.h"
+#include "../engine/physics/physics.h"
+#include "../engine/workers.h"
+#include "test_util.h"
+
+// the speculative solver against the sweep
+// usage: solver_test [--seed S], exits with 1 on the first failed check
+// bodies fall onto a floor and a platform made of tiles and slide along them into two walls,
+// once stepped by the sweep and once by the speculative solver, after every tick the bodies of both runs have to
+// be within POSITION_TOLERANCE and every static hit the sweep sent has to be sent by the speculative solver as well,
+// which sends a hit once per step for every static body the body stops against or slides along, where the sweep
+// sends one for each of its substeps, a body within POSITION_TOLERANCE of a static body at the start of a tick
+// may be on it in one run and past it in the other
+// float only, the fixed point sweep rounds the distance of its substeps down and falls behind a single pass
+
+#define WORLD_BODIES 48
+#define WORLD_STATICS (640 / TILE_SIZE + 4 + 2)
+#define WORLD_TICKS 240
+#define WORLD_STEP_RATE 64
+#define TILE_SIZE 32
+#define TICK_HITS_MAX 2048
+// the sweep lands on the contact point of its substep and adds the slide, the speculative solver adds the parts
+// in another order, which only rounds differently
+#define POSITION_TOLERANCE 0.01f
+#define BODY_HALF_SIZE 6
+
+typedef struct static_hit {
+    uint32 body_id, static_id;
+    vec2 normal;
+} Static_hit;
+
+typedef struct solver_run {
+    vec2 *positions;            // every body after every tick
+    Static_hit *hits;           // TICK_HITS_MAX for every tick
+    uint32 *hit_counts;
+} Solver_run;
+
+static AABB statics[WORLD_STATICS];
+
+static bool solver_run(Physics_solver solver, Solver_run *run, uint32 seed);
+static bool runs_compare(Solver_run *sweep, Solver_run *speculative);
+static bool hit_match(Static_hit *sweep, Static_hit *speculative);
+static bool static_near(uint32 static_id, vec2 pos);
+static void on_static_hit(Body *self, Static_body *other, Collision *hit);
+static float32 random_range(float32 low, float32 high);
+
+int main(int argc, char **argv) {
+    uint64 seed = 1;
+    Test_option options[] = {{.name = "--seed", .number = &seed}};
+    if (!test_options_parse(argc, argv, options, 1)) {
+        ERROR_RETURN(1, "usage: solver_test [--seed S]\n");
+    }
+
+    Solver_run runs[2];
+    for (uint32 r = 0; r < 2; r++) {
+        runs[r] = (Solver_run){
+            .positions = malloc((uint64) WORLD_BODIES * WORLD_TICKS * sizeof(vec2)),
+            .hits = malloc((uint64) TICK_HITS_MAX * WORLD_TICKS * sizeof(Static_hit)),
+            .hit_counts = malloc(WORLD_TICKS * sizeof(uint32))
+        };
+        if (!runs[r].positions || !runs[r].hits || !runs[r].hit_counts) {
+            ERROR_RETURN(1, "Unable to allocate memory for the runs\n");
+        }
+    }
+    if (!solver_run(PHYSICS_SOLVER_SWEEP, &runs[0], (uint32) seed) ||
+        !solver_run(PHYSICS_SOLVER_SPECULATIVE, &runs[1], (uint32) seed) || !runs_compare(&runs[0], &runs[1]))
+        return 1;
+
+    for (uint32 r = 0; r < 2; r++) {
+        free(runs[r].positions);
+        free(runs[r].hits);
+        free(runs[r].hit_counts);
+    }
+    return 0;
+}
+
+// the same world for a seed with either solver, the static hits are read from the queue before the dispatch
+static bool solver_run(Physics_solver solver, Solver_run *run, uint32 seed) {
+    physics_init(&(Physics_config){.solver = solver});
+    physics_fixed_step_set(WORLD_STEP_RATE, 1);
+    workers_init(1);
+    test_random_seed(seed);
+
+    for (uint32 t = 0; t < 640 / TILE_SIZE; t++) {
+        physics_static_body_create((Body_data){
+            .pos = {t * TILE_SIZE + TILE_SIZE * 0.5f, 8}, .size = {TILE_SIZE, 16}, .collision_layer = COLLISION_LAYER_TERRAIN
+        });
+    }
+    for (uint32 t = 0; t < 4; t++) {
+        physics_static_body_create((Body_data){
+            .pos = {256 + t * TILE_SIZE + TILE_SIZE * 0.5f, 120}, .size = {TILE_SIZE, 16},
+            .collision_layer = COLLISION_LAYER_TERRAIN
+        });
+    }
+    physics_static_body_create((Body_data){.pos = {8, 180}, .size = {16, 360}, .collision_layer = COLLISION_LAYER_TERRAIN});
+    physics_static_body_create((Body_data){.pos = {632, 180}, .size = {16, 360}, .collision_layer = COLLISION_LAYER_TERRAIN});
+    physics_static_bake();
+    for (uint32 s = 0; s < WORLD_STATICS; s++)
+        statics[s] = physics_static_body_get(s)->aabb;
+
+    // above the platform, fast enough on the way down for several substeps of the sweep
+    for (uint32 b = 0; b < WORLD_BODIES; b++) {
+        uint64 handle = physics_body_create(&(Body_data){
+            .pos = {random_range(40, 600), random_range(140, 340)}, .size = {BODY_HALF_SIZE * 2, BODY_HALF_SIZE * 2},
+            .velocity = {random_range(-600, 600), random_range(-900, 300)},
+            .collision_layer = COLLISION_LAYER_ENEMY, .collision_mask = COLLISION_LAYER_TERRAIN
+        }, NULL, on_static_hit);
+        if (handle == -1) {
+            ERROR_RETURN(false, "Unable to create test body\n");
+        }
+    }
+
+    Collision_event events[TICK_HITS_MAX];
+    for (uint32 t = 0; t < WORLD_TICKS; t++) {
+        physics_frame_begin(1.0f / WORLD_STEP_RATE);
+        physics_update();
+        uint64 count = physics_events_filter(UINT32_MAX, UINT32_MAX, events, TICK_HITS_MAX);
+        if (count == TICK_HITS_MAX) {
+            ERROR_RETURN(false, "Tick %u sent more static hits than the test has room for\n", t);
+        }
+        run->hit_counts[t] = 0;
+        for (uint64 e = 0; e < count; e++) {
+            if (events[e].kind != COLLISION_EVENT_STATIC_HIT) continue;
+            run->hits[t * TICK_HITS_MAX + run->hit_counts[t]++] = (Static_hit){
+                .body_id = events[e].self_id, .static_id = events[e].other_id,
+                .normal = {events[e].normal[0], events[e].normal[1]}
+            };
+        }
+        physics_events_dispatch();
+        for (uint32 b = 0; b < WORLD_BODIES; b++) {
+            Body *body = physics_body_at(b);
+            run->positions[t * WORLD_BODIES + b][0] = body->pos[0];
+            run->positions[t * WORLD_BODIES + b][1] = body->pos[1];
+        }
+    }
+    workers_exit();
+    physics_exit();
+    return true;
+}
+
+static bool runs_compare(Solver_run *sweep, Solver_run *speculative) {
+    uint64 hit_total = 0;
+    for (uint32 t = 0; t < WORLD_TICKS; t++) {
+        for (uint32 b = 0; b < WORLD_BODIES; b++) {
+            float32 *a = sweep->positions[t * WORLD_BODIES + b], *c = speculative->positions[t * WORLD_BODIES + b];
+            if (!(fabsf(a[0] - c[0]) <= POSITION_TOLERANCE && fabsf(a[1] - c[1]) <= POSITION_TOLERANCE)) {
+                ERROR_RETURN(false, "Body %u at tick %u is at (%g, %g) with the sweep and at (%g, %g) with the speculative solver\n",
+                             b, t, a[0], a[1], c[0], c[1]);
+            }
+        }
+        Static_hit *hits = &sweep->hits[t * TICK_HITS_MAX], *found = &speculative->hits[t * TICK_HITS_MAX];
+        for (uint32 h = 0; h < sweep->hit_counts[t]; h++) {
+            uint32 f = 0;
+            while (f < speculative->hit_counts[t] && !hit_match(&hits[h], &found[f]))
+                f++;
+            bool near = t > 0 && static_near(hits[h].static_id, speculative->positions[(t - 1) * WORLD_BODIES + hits[h].body_id]);
+            if (f == speculative->hit_counts[t] && !near) {
+                ERROR_RETURN(false, "Tick %u the speculative solver missed the hit of body %u on static body %u with normal (%g, %g)\n",
+                             t, hits[h].body_id, hits[h].static_id, hits[h].normal[0], hits[h].normal[1]);
+            }
+        }
+        hit_total += speculative->hit_counts[t];
+    }
+    printf("solver_test: %u bodies over %u ticks within %g units of the sweep, %" PRIu64 " static hits\n",
+           WORLD_BODIES, WORLD_TICKS, POSITION_TOLERANCE, hit_total);
+    return true;
+}
+
+// the sweep merges the normals of static bodies it runs into at the same time, like a floor and a wall,
+// so its normal only has to have the axis of the speculative one
+static bool hit_match(Static_hit *sweep, Static_hit *speculative) {
+    if (sweep->body_id != speculative->body_id || sweep->static_id != speculative->static_id) return false;
+    for (uint8 i = 0; i < 2; i++)
+        if (speculative->normal[i] != 0 && speculative->normal[i] == sweep->normal[i]) return true;
+    return false;
+}
+
+static bool static_near(uint32 static_id, vec2 pos) {
+    AABB *box = &statics[static_id];
+    for (uint8 i = 0; i < 2; i++)
+        if (fabsf(pos[i] - box->pos[i]) - box->half_size[i] - BODY_HALF_SIZE > POSITION_TOLERANCE) return false;
+    return true;
+}
+
+// stops the body along the normal, the same for one hit a step or one for each substep
+static void on_static_hit(Body *self, Static_body *other, Collision *hit) {
+    for (uint8 i = 0; i < 2; i++)
+        if (hit->normal[i] != 0) self->velocity[i] = 0;
+}
+
+static float32 random_range(float32 low, float32 high) {
+    return low + (high - low) * (float32) (test_random_next() >> 8) / (float32) (1 << 24);
+}
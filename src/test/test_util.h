@@ -0,0 +1,47 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../engine/types.h"
+
+// helpers shared by the test programs, header only so every test target keeps its single source file
+
+// "--name value" argument of a test, number or text is set depending on the kind of value
+typedef struct test_option {
+    const char *name;
+    uint64 *number;
+    const char **text;
+} Test_option;
+
+static uint32 test_random_state = 1;
+
+// fills the options from argv, false on an unknown name or a name without a value
+static inline bool test_options_parse(int argc, char **argv, Test_option *options, uint32 option_count) {
+    if (argc % 2 == 0) return false;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        uint32 o = 0;
+        while (o < option_count && strcmp(argv[i], options[o].name) != 0) o++;
+        if (o == option_count) return false;
+        if (options[o].number) *options[o].number = strtoull(argv[i + 1], NULL, 10);
+        else *options[o].text = argv[i + 1];
+    }
+    return true;
+}
+
+// 0 would keep xorshift at 0 forever
+static inline void test_random_seed(uint32 seed) {
+    test_random_state = seed ? seed : 1;
+}
+
+// xorshift32, the same cases on every platform for a seed
+static inline uint32 test_random_next(void) {
+    test_random_state ^= test_random_state << 13;
+    test_random_state ^= test_random_state >> 17;
+    test_random_state ^= test_random_state << 5;
+    return test_random_state;
+}
+
+#endif // !TEST_UTIL_H
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../engine/types.h"
+#include "../engine/utils.h"
+#include "../engine/physics/physics.h"
+#include "../engine/physics/tilemap.h"
+#include "test_util.h"
+
+// the greedy mesher and the chunk rebuilds of the tilemap
+// usage: tilemap_test [--edits N] [--seed S], exits with 1 on the first failed check
+// after the first build and after every edit the static bodies have to cover each colliding tile exactly once
+// with the layer of the tile and nothing else, and box queries and raycasts through the static tree, which
+// chunk edits only refit, have to find the same static bodies as a test of every static body
+
+#define MAP_WIDTH 100
+#define MAP_HEIGHT 70
+#define TILE_SIZE 16
+#define QUERY_COUNT 64
+#define HITS_MAX 4096
+
+static uint16 coverage[MAP_HEIGHT][MAP_WIDTH];
+static Physics_query_hit hits[HITS_MAX];
+static bool found[HITS_MAX];
+
+static bool mesh_check(Tilemap *map);
+static bool queries_check(void);
+static uint8 random_tile(void);
+
+int main(int argc, char **argv) {
+    uint64 edit_count = 400, seed = 1;
+    Test_option options[] = {{.name = "--edits", .number = &edit_count}, {.name = "--seed", .number = &seed}};
+    if (!test_options_parse(argc, argv, options, 2)) {
+        ERROR_RETURN(1, "usage: tilemap_test [--edits N] [--seed S]\n");
+    }
+    test_random_seed((uint32) seed);
+
+    physics_init(NULL);
+    Tilemap map;
+    if (!tilemap_init(&map, MAP_WIDTH, MAP_HEIGHT, TILE_SIZE, (vec2){-40, 24})) return 1;
+    tilemap_tile_layer_set(&map, 1, COLLISION_LAYER_TERRAIN);
+    tilemap_tile_layer_set(&map, 2, COLLISION_LAYER_TERRAIN);
+    tilemap_tile_layer_set(&map, 3, COLLISION_LAYER_ENEMY_PASSTHROUGH);
+    // tile 4 is decoration without a layer
+
+    for (uint32 y = 0; y < MAP_HEIGHT; y++)
+        for (uint32 x = 0; x < MAP_WIDTH; x++)
+            tilemap_tile_set(&map, x, y, random_tile());
+    tilemap_build(&map);
+    physics_static_bake();
+    if (!mesh_check(&map) || !queries_check()) return 1;
+
+    uint64 tile_count = 0;
+    for (uint32 y = 0; y < MAP_HEIGHT; y++)
+        for (uint32 x = 0; x < MAP_WIDTH; x++)
+            tile_count += coverage[y][x];
+    printf("tilemap_test: %" PRIu64 " colliding tiles in %" PRIu64 " static bodies\n",
+           tile_count, tilemap_static_body_count(&map));
+
+    for (uint32 e = 0; e < edit_count; e++) {
+        uint32 x = test_random_next() % MAP_WIDTH, y = test_random_next() % MAP_HEIGHT;
+        uint32 old_layer = map.tile_layers[tilemap_tile_get(&map, x, y)];
+        uint8 tile_id = random_tile();
+        tilemap_tile_set(&map, x, y, tile_id);
+        // the empty tile 0 never gets a layer
+        bool changed = map.tile_layers[tile_id] != old_layer;
+        uint64 rebuilt = tilemap_build(&map);
+        if (rebuilt != (changed ? 1 : 0)) {
+            ERROR_RETURN(1, "Edit %u at (%u, %u) rebuilt %" PRIu64 " chunks\n", e, x, y, rebuilt);
+        }
+        if (!mesh_check(&map) || !queries_check()) {
+            ERROR_RETURN(1, "Edit %u at (%u, %u) broke the static bodies\n", e, x, y);
+        }
+    }
+    printf("tilemap_test: %" PRIu64 " edits, %" PRIu64 " static bodies, all match\n", edit_count, tilemap_static_body_count(&map));
+
+    tilemap_exit(&map);
+    physics_exit();
+    return 0;
+}
+
+// counts how often each tile is covered by an active static body, every body has to sit on the tile grid
+static bool mesh_check(Tilemap *map) {
+    memset(coverage, 0, sizeof(coverage));
+    uint64 body_count = 0;
+    for (uint64 i = 0; i < physics_static_body_count(); i++) {
+        Static_body *static_body = physics_static_body_get(i);
+        if (!static_body->active) continue;
+        body_count++;
+        AABB *aabb = &static_body->aabb;
+        uint32 x0 = (uint32) ((aabb->pos[0] - aabb->half_size[0] - map->origin[0]) / TILE_SIZE);
+        uint32 y0 = (uint32) ((aabb->pos[1] - aabb->half_size[1] - map->origin[1]) / TILE_SIZE);
+        uint32 x1 = (uint32) ((aabb->pos[0] + aabb->half_size[0] - map->origin[0]) / TILE_SIZE);
+        uint32 y1 = (uint32) ((aabb->pos[1] + aabb->half_size[1] - map->origin[1]) / TILE_SIZE);
+        if (x1 > MAP_WIDTH || y1 > MAP_HEIGHT || x0 >= x1 || y0 >= y1 ||
+            (x0 / TILEMAP_CHUNK_SIZE) != (x1 - 1) / TILEMAP_CHUNK_SIZE ||
+            (y0 / TILEMAP_CHUNK_SIZE) != (y1 - 1) / TILEMAP_CHUNK_SIZE) {
+            ERROR_RETURN(false, "Static body %" PRIu64 " leaves its chunk or the map\n", i);
+        }
+        for (uint32 y = y0; y < y1; y++) {
+            for (uint32 x = x0; x < x1; x++) {
+                if (map->tile_layers[tilemap_tile_get(map, x, y)] != static_body->collision_layer) {
+                    ERROR_RETURN(false, "Static body %" PRIu64 " covers tile (%u, %u) of another layer\n", i, x, y);
+                }
+                coverage[y][x]++;
+            }
+        }
+    }
+
+    for (uint32 y = 0; y < MAP_HEIGHT; y++) {
+        for (uint32 x = 0; x < MAP_WIDTH; x++) {
+            uint32 expected = map->tile_layers[tilemap_tile_get(map, x, y)] != 0;
+            if (coverage[y][x] != expected) {
+                ERROR_RETURN(false, "Tile (%u, %u) is covered %u times\n", x, y, coverage[y][x]);
+            }
+        }
+    }
+    if (body_count != tilemap_static_body_count(map)) {
+        ERROR_RETURN(false, "%" PRIu64 " static bodies are active but the tilemap made %" PRIu64 "\n",
+                     body_count, tilemap_static_body_count(map));
+    }
+    return true;
+}
+
+// tree results against every active static body, boxes and rays anywhere around the map
+static bool queries_check(void) {
+    for (uint32 q = 0; q < QUERY_COUNT; q++) {
+        vec2 pos = {(float32) (test_random_next() % (MAP_WIDTH * TILE_SIZE + 200)) - 140,
+                    (float32) (test_random_next() % (MAP_HEIGHT * TILE_SIZE + 200)) - 76};
+        vec2 extent = {(float32) (test_random_next() % 200), (float32) (test_random_next() % 200)};
+        bool ray = q % 2;
+        if (ray && test_random_next() % 3 == 0) extent[test_random_next() % 2] = 0;
+        AABB box = {.pos = {pos[0], pos[1]}, .half_size = {extent[0] * 0.5f, extent[1] * 0.5f}};
+
+        uint64 count = ray ? physics_raycast_all(pos, extent, UINT32_MAX, hits, HITS_MAX) :
+                             physics_query_aabb(&box, UINT32_MAX, hits, HITS_MAX);
+        uint64 static_count = physics_static_body_count();
+        if (static_count > HITS_MAX) {
+            ERROR_RETURN(false, "More static bodies than the query check has room for\n");
+        }
+        memset(found, 0, sizeof(found));
+        for (uint64 h = 0; h < count; h++) {
+            if (!hits[h].is_static || found[hits[h].id]) {
+                ERROR_RETURN(false, "Query %u found body %u twice or a body which is not static\n", q, hits[h].id);
+            }
+            found[hits[h].id] = true;
+        }
+        for (uint64 i = 0; i < static_count; i++) {
+            Static_body *static_body = physics_static_body_get(i);
+            bool expected = static_body->active &&
+                            (ray ? ray_collide_aabb(pos, extent, static_body->aabb).collided
+                                 : physics_aabb_intersect(&box, &static_body->aabb));
+            if (expected != found[i]) {
+                ERROR_RETURN(false, "%s %u %s static body %" PRIu64 "\n", ray ? "Raycast" : "Box query", q,
+                             expected ? "missed" : "found the destroyed or distant", i);
+            }
+        }
+    }
+    return true;
+}
+
+// mostly empty tiles and long runs of one layer so the mesher has rectangles to merge
+static uint8 random_tile(void) {
+    uint32 roll = test_random_next() % 16;
+    if (roll < 7) return 0;
+    if (roll < 12) return 1;
+    if (roll < 14) return 2;
+    return (uint8) (roll - 11);
+}